@@ -23,6 +23,12 @@ void write_color(std::ostream& out, color pixel_color, int samples_per_pixel) {
     // Write out the translated [0, 255] value of each color component.
     out << static_cast<int>(256 * fclamp(r, 0.0, .9999)) << ' '
         << static_cast<int>(256 * fclamp(g, 0.0, .9999)) << ' '
-        << static_cast<int>(256 * fclamp(b, 0.0, .9999)) << std::endl;
+        << static_cast<int>(256 * fclamp(b, 0.0, .9999)) << '\n';
 }
+
+inline float luminance(const color& c) {
+    // Rec. 709 luma weights
+    return .2126f*c.x() + .7152f*c.y() + .0722f*c.z();
+}
+
 #endif //RAYTRACING_COLOR_HPP
@@ -5,16 +5,28 @@
 #ifndef RAYTRACING_DENOISE_HPP
 #define RAYTRACING_DENOISE_HPP
 
+#ifdef RAYTRACING_DENOISE
 #include <OpenImageDenoise/oidn.hpp>
+#endif
 
+#include "parallel/framebuffer.hpp"
 #include "parallel/params.hpp"
 
-void data_denoise(std::vector<float>& data) {
+bool data_denoise([[maybe_unused]] frame_planes& data) {
+    // Denoises the per-pixel means and writes them back scaled by the sample counts. False if
+    // built without OpenImageDenoise, which leaves data as it is.
+#ifndef RAYTRACING_DENOISE
+    std::cout << "Built without OpenImageDenoise; the image is left as rendered." << std::endl;
+    return false;
+#else
     std::vector<float> input(params::HEIGHT * params::WIDTH * 3);
-    for(int i=0, j=0; i < data.size(); i += 5, j += 3) {
-        input[j] = data[i];
-        input[j+1] = data[i+1];
-        input[j+2] = data[i+2];
+    for(unsigned y=0, j=0; y < params::HEIGHT; ++y) {
+        for(unsigned x=0; x < params::WIDTH; ++x, j += 3) {
+            const color c = data.mean(x, y);
+            input[j] = c.x();
+            input[j+1] = c.y();
+            input[j+2] = c.z();
+        }
     }
     oidn::DeviceRef device = oidn::newDevice();
     device.commit();
@@ -30,10 +42,15 @@ void data_denoise(std::vector<float>& data) {
     if (device.getError(errorMessage) != oidn::Error::None)
         std::cout << "Error: " << errorMessage << std::endl;
 
-    for(int i=0, j=0; i < data.size(); i += 5, j += 3) {
-        data[i] = input[j];
-        data[i+1] = input[j+1];
-        data[i+2] = input[j+2];
+    for(unsigned y=0, j=0; y < params::HEIGHT; ++y) {
+        for(unsigned x=0; x < params::WIDTH; ++x, j += 3) {
+            const float n = data.samples(x, y);
+            data.at(frame_planes::red, x, y) = input[j] * n;
+            data.at(frame_planes::green, x, y) = input[j+1] * n;
+            data.at(frame_planes::blue, x, y) = input[j+2] * n;
+        }
     }
+    return true;
+#endif
 }
 #endif //RAYTRACING_DENOISE_HPP
@@ -0,0 +1,345 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <future>
+#include <optional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "scene_select.hpp"
+#include "raytracer.hpp"
+#include "denoise.hpp"
+#include "parallel/distributed.hpp"
+#include "parallel/params.hpp"
+#include "parallel/image_output.hpp"
+#include "parallel/renderer.hpp"
+#include "parallel/sequence.hpp"
+#include "parallel/stream.hpp"
+
+// Batch renderer without a window: renders one scene and writes it to disk, in this process or
+// spread over worker processes
+
+constexpr unsigned scene_seed = 1;
+
+volatile std::sig_atomic_t interrupted = 0;
+
+void on_signal(int) {
+    interrupted = 1;
+}
+
+void usage() {
+    std::cerr << "usage: RayTracingHeadless [options]\n"
+                 "  --scene NAME|FILE.obj  scene to render (random)\n"
+                 "  --width N              image width; the height follows the scene's aspect ratio\n"
+                 "  --spp N                samples per pixel\n"
+                 "  --threads N            render threads (all cores)\n"
+                 "  --out FILE             where to write the image, as .ppm, .png, .pfm or .exr (output/out.ppm)\n"
+                 "  --workers N            render in N worker processes with --threads each, 0 for none\n"
+                 "  --chunk N              samples per unit of work sent to a worker process (spp/4)\n"
+                 "  --worker-timeout S     drop a worker process that sends nothing for S seconds while it\n"
+                 "                         has work, and hand its work to the others (60)\n"
+                 "  --frames N             render an N frame sequence over the scene's time 0 to 1, numbered\n"
+                 "                         from 0 in the --out name\n"
+                 "  --orbit DEG            turn the camera this far around its target over the sequence\n"
+                 "  --checkpoint FILE      save the render to FILE periodically and on SIGINT or SIGTERM;\n"
+                 "                         not with --workers or --frames\n"
+                 "  --checkpoint-every S   seconds between checkpoints (60)\n"
+                 "  --resume               carry on from the checkpoint file if there is one, or with --stream\n"
+                 "                         from the tiles already in the image\n"
+                 "  --stream               write tiles into the --out .exr as they finish instead of keeping\n"
+                 "                         the frame in memory, for images too large for that\n"
+                 "  --tile-cost FILE       also write a .png or .ppm map of render time per pixel of each tile,\n"
+                 "                         when rendering one frame in this process\n"
+                 "  --numa                 pin render threads to cores across NUMA nodes and spread the scene\n"
+                 "                         and frame over the nodes' memory, when rendering in this process\n"
+                 "  --denoise              denoise with OpenImageDenoise if built with it\n"
+                 "  --quiet                no progress reports\n"
+                 "  --list                 print the scene names\n";
+}
+
+std::string numbered(const std::string& path, unsigned n) {
+    // path with _0000 and so on before its extension
+    char digits[16];
+    std::snprintf(digits, sizeof digits, "_%04u", n);
+    const auto dot = path.find_last_of('.');
+    const auto slash = path.find_last_of('/');
+    if(dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        return path + digits;
+    return path.substr(0, dot) + digits + path.substr(dot);
+}
+
+int main(int argc, char* argv[]) {
+    std::string scene_name = "random", out_path = "output/out.ppm", cost_path;
+    unsigned threads = 0, width = params::WIDTH, spp = params::N_samples, workers = 0, chunk = 0, frames = 0;
+    float orbit = 0, worker_timeout = 60;
+    bool denoise = false, quiet = false, worker = false, resume = false, stream = false;
+    checkpoint_plan plan;
+
+    for(int i=1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if(arg == "--scene" && has_value) scene_name = argv[++i];
+        else if(arg == "--width" && has_value) width = std::strtoul(argv[++i], nullptr, 10);
+        else if(arg == "--spp" && has_value) spp = std::strtoul(argv[++i], nullptr, 10);
+        else if(arg == "--threads" && has_value) threads = std::strtoul(argv[++i], nullptr, 10);
+        else if(arg == "--out" && has_value) out_path = argv[++i];
+        else if(arg == "--workers" && has_value) workers = std::strtoul(argv[++i], nullptr, 10);
+        else if(arg == "--chunk" && has_value) chunk = std::strtoul(argv[++i], nullptr, 10);
+        else if(arg == "--worker-timeout" && has_value) worker_timeout = std::strtof(argv[++i], nullptr);
+        else if(arg == "--worker") worker = true; // started by a coordinator, see spawn_worker
+        else if(arg == "--frames" && has_value) frames = std::strtoul(argv[++i], nullptr, 10);
+        else if(arg == "--orbit" && has_value) orbit = std::strtof(argv[++i], nullptr);
+        else if(arg == "--checkpoint" && has_value) plan.path = argv[++i];
+        else if(arg == "--checkpoint-every" && has_value) plan.every_seconds = std::strtof(argv[++i], nullptr);
+        else if(arg == "--resume") resume = true;
+        else if(arg == "--stream") stream = true;
+        else if(arg == "--tile-cost" && has_value) cost_path = argv[++i];
+        else if(arg == "--numa") params::NUMA = true;
+        else if(arg == "--denoise") denoise = true;
+        else if(arg == "--quiet") quiet = true;
+        else if(arg == "--list") {
+            for(auto& n : scene_names()) std::cout << n << '\n';
+            return 0;
+        }
+        else {
+            usage();
+            return 1;
+        }
+    }
+    if(width == 0 || spp == 0) {
+        usage();
+        return 1;
+    }
+    if(!worker && format_of(out_path) == image_format::unknown) {
+        std::cerr << "Can't tell the image format of " << out_path << "; use .ppm, .png, .pfm or .exr" << std::endl;
+        return 1;
+    }
+    if(stream && (format_of(out_path) != image_format::exr || workers > 0 || frames > 0 || denoise || !plan.path.empty())) {
+        std::cerr << "--stream writes one .exr in this process, without --workers, --frames, --denoise or --checkpoint"
+                  << std::endl;
+        return 1;
+    }
+    if(!cost_path.empty() && (workers > 0 || frames > 0 || stream
+                              || (format_of(cost_path) != image_format::png && format_of(cost_path) != image_format::ppm))) {
+        std::cerr << "--tile-cost writes a .png or .ppm of one frame rendered in this process, without --workers, "
+                     "--frames or --stream" << std::endl;
+        return 1;
+    }
+    if(!plan.path.empty() && (workers > 0 || frames > 0)) {
+        std::cerr << "--checkpoint saves a single frame rendered in this process, without --workers or --frames"
+                  << std::endl;
+        return 1;
+    }
+
+    if(threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency() / std::max(workers, 1u));
+
+    // Rendering here: workers are created before the interleave policy, which new threads would inherit
+    std::optional<renderer> rend;
+    std::optional<interleave_memory> shared_memory;
+    if(workers == 0 && !worker && !stream) {
+        rend.emplace(threads, params::NUMA);
+        shared_memory.emplace(rend->topology(), params::NUMA);
+        if(params::NUMA && !quiet) std::cerr << rend->placement() << std::endl;
+    }
+
+    // Every process builds the same scene, random placements included
+    seed_random(scene_seed);
+    scene_setup setup;
+    if(!select_scene(scene_name, setup)) {
+        std::cerr << "Unknown scene " << scene_name << "; see --list" << std::endl;
+        return 1;
+    }
+    seed_random(std::random_device{}());
+    params::ASPECT_RATIO = setup.aspect_ratio;
+    params::WIDTH = width;
+    params::HEIGHT = std::max(1, int(float(width) / params::ASPECT_RATIO));
+    params::N_samples = spp;
+
+    if(worker) {
+        setup.scn.build_lights();
+        camera cam = setup.make_camera();
+        run_worker(wire::worker_fd, setup.scn, cam, threads);
+        return 0;
+    }
+
+    if(stream) {
+        std::cerr << "Streaming " << scene_name << " at " << params::WIDTH << "x" << params::HEIGHT << ", " << spp
+                  << " spp on " << threads << " threads to " << out_path << std::endl;
+        streamed_exr out;
+        std::string why;
+        if(!out.open(out_path, scene_name, (uint64_t(std::random_device{}()) << 32) | std::random_device{}(), resume, why)) {
+            std::cerr << why << std::endl;
+            return 1;
+        }
+        if(out.finished_count()) std::cerr << "Resuming with " << out.finished_count() << " of " << out.size() << " tiles done" << std::endl;
+
+        std::signal(SIGINT, on_signal);
+        std::signal(SIGTERM, on_signal);
+        const Timer timer;
+        const bool complete = render_streamed(setup.scn, setup.make_camera(), threads, out, [&] {
+            if(!quiet) std::cerr << "\r" << out.finished_count() << " of " << out.size() << " tiles done   " << std::flush;
+            return !interrupted;
+        });
+        if(!quiet) std::cerr << "\r" << std::string(40, ' ') << "\r";
+        if(!complete) {
+            std::cerr << "Stopped after " << timer.elapsed() << " s with " << out.finished_count() << " of " << out.size()
+                      << " tiles in " << out_path << "; --resume carries on" << std::endl;
+            return 1;
+        }
+        out.finish();
+        std::cerr << "Finished in " << timer.elapsed() << " s" << std::endl;
+        std::cerr << "Saved image to " << out_path << std::endl;
+        return 0;
+    }
+
+    if(frames > 0) {
+        if(workers > 0) {
+            std::cerr << "Sequences render in this process; drop --workers" << std::endl;
+            return 1;
+        }
+        std::cerr << "Rendering " << frames << " frames of " << scene_name << " at " << params::WIDTH << "x"
+                  << params::HEIGHT << ", " << spp << " spp on " << rend->threads() << " threads" << std::endl;
+        const Timer timer;
+        image_writer writer;
+        std::vector<std::pair<std::string, std::future<bool>>> written;
+        sequence_renderer sequence(*rend, [&](unsigned f) {
+            // Frame f is exposed for half its share of the scene's time and seen from the
+            // scene's camera turned around its target by its share of the orbit
+            seed_random(scene_seed);
+            scene_setup s;
+            select_scene(scene_name, s);
+            const float t = float(f) / float(frames);
+            s.time0 = t;
+            s.time1 = t + .5f / float(frames);
+            const float a = degrees_to_radians(orbit * t);
+            const vec3 v = s.lookfrom - s.lookat;
+            s.lookfrom = s.lookat + vec3(v.x() * cosf(a) - v.z() * sinf(a), v.y(), v.x() * sinf(a) + v.z() * cosf(a));
+            return s;
+        }, [&](unsigned f, frame_planes& image) {
+            if(denoise) data_denoise(image);
+            std::string path = numbered(out_path, f);
+            if(!quiet) std::cerr << "Rendered frame " << f << " at " << timer.elapsed() << " s" << std::endl;
+            written.emplace_back(path, writer.write(path, std::move(image)));
+        });
+        try {
+            sequence.run(0, frames);
+        }
+        catch(const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+        bool saved = true;
+        for(auto& [path, ok] : written)
+            if(!ok.get()) {
+                std::cerr << "Couldn't write " << path << std::endl;
+                saved = false;
+            }
+        std::cerr << "Finished in " << timer.elapsed() << " s" << std::endl;
+        return saved ? 0 : 1;
+    }
+
+    frame_planes data;
+    std::vector<uint8_t> cost_map;
+    bool own_checkpoint = false; // written or resumed from by this run, so done with once the image is saved
+    if(workers > 0) {
+        std::cerr << "Rendering " << scene_name << " at " << params::WIDTH << "x" << params::HEIGHT << ", " << spp
+                  << " spp in " << workers << " processes of " << threads << " threads" << std::endl;
+        const Timer timer;
+        framebuffer fb(params::WIDTH, params::HEIGHT);
+        coordinator coord(fb, params::N, params::TILE_ORDER, spp, chunk ? chunk : (spp + 3) / 4, 2 * threads, worker_timeout);
+        for(unsigned w=0; w < workers; ++w) {
+            std::vector<std::string> args{argv[0], "--worker", "--scene", scene_name, "--width", std::to_string(width),
+                                          "--spp", std::to_string(spp), "--threads", std::to_string(threads)};
+            int fd;
+            pid_t pid;
+            if(spawn_worker(args, fd, pid))
+                coord.add_worker(fd, pid);
+            else
+                std::cerr << "Couldn't start worker " << w << std::endl;
+        }
+        const bool complete = coord.run([&] {
+            if(!quiet) std::cerr << "\r" << int(coord.fraction_done() * 100) << "% done   " << std::flush;
+        });
+        if(!quiet) std::cerr << "\r" << std::string(40, ' ') << "\r";
+        if(coord.workers_lost())
+            std::cerr << coord.workers_lost() << " workers lost, " << coord.units_reissued() << " units reissued" << std::endl;
+        if(!complete) {
+            std::cerr << "Every worker was lost with " << int(coord.fraction_done() * 100) << "% done" << std::endl;
+            return 1;
+        }
+        std::cerr << "Finished in " << timer.elapsed() << " s" << std::endl;
+        data = fb.snapshot();
+    }
+    else {
+        std::cerr << "Rendering " << scene_name << " at " << params::WIDTH << "x" << params::HEIGHT << ", " << spp
+                  << " spp on " << rend->threads() << " threads" << std::endl;
+
+        checkpoint saved;
+        const bool resuming = resume && !plan.path.empty() && saved.read(plan.path);
+        plan.label = scene_name;
+        if(resuming && !saved.matches(plan.label)) {
+            std::cerr << plan.path << " is from a different scene or settings" << std::endl;
+            return 1;
+        }
+        if(resuming) std::cerr << "Resuming from " << plan.path << std::endl;
+
+        std::signal(SIGINT, on_signal);
+        std::signal(SIGTERM, on_signal);
+        auto job = rend->submit(setup.scn, setup.make_camera(), plan, resuming ? &saved : nullptr);
+        while(job->future().wait_for(std::chrono::seconds(1)) != std::future_status::ready) {
+            if(interrupted) job->cancel();
+            if(quiet) continue;
+            const float eta = job->eta_seconds();
+            std::cerr << "\r" << int(job->fraction_done() * 100) << "% done";
+            if(eta >= 0) std::cerr << ", about " << int(eta + .5f) << " s left   ";
+            std::cerr << std::flush;
+        }
+        job->get();
+        if(!quiet) std::cerr << "\r" << std::string(40, ' ') << "\r";
+        if(job->cancelled()) {
+            std::cerr << "Stopped after " << job->elapsed() << " s";
+            if(!plan.path.empty()) std::cerr << "; --resume carries on from " << plan.path;
+            std::cerr << std::endl;
+            return 1;
+        }
+        std::cerr << "Finished in " << job->elapsed() << " s" << std::endl;
+        data = job->snapshot();
+        own_checkpoint = resuming || job->checkpoints() > 0;
+        if(!cost_path.empty()) cost_map = pixels(params::WIDTH, params::HEIGHT).get_tile_cost_map(job->tiles());
+    }
+
+    float min_spp = f_infinity, max_spp = 0;
+    for(unsigned y=0; y < data.height(); ++y)
+        for(unsigned x=0; x < data.width(); ++x) {
+            min_spp = fmin(min_spp, data.samples(x, y));
+            max_spp = fmax(max_spp, data.samples(x, y));
+        }
+    std::cerr << "Samples per pixel from " << min_spp << " to " << max_spp << std::endl;
+
+    if(denoise) data_denoise(data);
+
+    if(!write_image(out_path, data)) {
+        std::cerr << "Couldn't write " << out_path << std::endl;
+        return 1;
+    }
+    std::cerr << "Saved image to " << out_path << std::endl;
+    if(own_checkpoint) std::remove(plan.path.c_str());
+    if(!cost_path.empty()) {
+        image_writer writer;
+        if(!writer.write(cost_path, std::move(cost_map), params::WIDTH, params::HEIGHT).get()) {
+            std::cerr << "Couldn't write " << cost_path << std::endl;
+            return 1;
+        }
+        std::cerr << "Saved render time per tile to " << cost_path << std::endl;
+    }
+    return 0;
+}
@@ -28,6 +28,7 @@ public:
         rec.normal = normal;
         get_plane_uv(rec.p, rec.u, rec.v);
         rec.mat_ptr = mat_ptr;
+        rec.obj = this;
 
         return hit;
     }
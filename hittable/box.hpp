@@ -25,6 +25,17 @@ public:
         return true;
     }
 
+    void collect_lights(std::vector<light_info>& lights) const override {
+        sides.collect_lights(lights);
+    }
+
+    bool hit_interval(const ray& r, float& t_enter, float& t_exit) const override {
+        // Slab test against the box itself instead of its six sides
+        t_enter = -f_infinity;
+        t_exit = f_infinity;
+        return aabb(box_min, box_max).hit(r, t_enter, t_exit);
+    }
+
 public:
     point3 box_min;
     point3 box_max;
@@ -26,6 +26,11 @@ public:
 
     bool bounding_box(float time0, float time1, aabb& output_box) const override;
 
+    void collect_lights(std::vector<light_info>& lights) const override {
+        left->collect_lights(lights);
+        if(right != left) right->collect_lights(lights);
+    }
+
 public:
     shared_ptr<hittable> left;
     shared_ptr<hittable> right;
@@ -86,7 +91,7 @@ bvh_node::bvh_node(const std::vector<shared_ptr<hittable>> &src_objects,
     else if(object_span == 2) {
         if(comparator(objects[start], objects[start+1])) {
             left = objects[start];
-            right = objects[start];
+            right = objects[start+1];
         }
         else {
             left = objects[start+1];
@@ -89,6 +89,7 @@ bool cone::hit(const ray &r, float t_min, float t_max, hit_record &rec) const {
     if(t == INT_MIN || t > t_max || t < t_min)
         return false;
     rec.mat_ptr = mat_ptr;
+    rec.obj = this;
     rec.t = t;
     rec.p = r.at(t);
     rec.set_face_normal(r, outward_normal);
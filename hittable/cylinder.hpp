@@ -87,6 +87,7 @@ bool cylinder::hit(const ray& r, float t_min, float t_max, hit_record& rec) cons
         return false;
     }
     rec.mat_ptr = mat_ptr;
+    rec.obj = this;
     rec.t = t;
     rec.p = r.at(t);
     rec.set_face_normal(r, outward_normal);
@@ -6,17 +6,20 @@
 #define RAYTRACING_HITTABLE_HPP
 
 #include <utility>
+#include <vector>
 
 #include "ray.hpp"
 #include "rtweekend.hpp"
 #include "aabb.hpp"
 
 class material;
+class hittable;
 
 struct hit_record {
     point3 p;
     vec3 normal;
     shared_ptr<material> mat_ptr;
+    const hittable* obj{}; // primitive (or light wrapper) that was hit
     float t;
     float u;
     float v;
@@ -28,10 +31,40 @@ struct hit_record {
     }
 };
 
+struct light_info {
+    // What the light tree needs to know about a shape that may emit
+    const hittable* obj;
+    aabb box;
+    vec3 axis;          // direction the front face emits toward
+    float cos_theta_o;  // spread of the normals around axis, -1 for spheres
+    float area;
+    shared_ptr<material> mat;
+};
+
 class hittable {
 public:
     virtual bool hit(const ray& r, float t_min, float t_max, hit_record& rec) const = 0;
     virtual bool bounding_box(float time0, float time1, aabb& output_box) const = 0;
+
+    // Light sampling: solid angle pdf of direction v from o, and a random direction toward the shape
+    [[nodiscard]] virtual float pdf_value(const point3&, const vec3&) const { return 0; }
+    [[nodiscard]] virtual vec3 random(const point3&) const { return vec3(1, 0, 0); }
+
+    // Shapes that support light sampling report themselves here
+    virtual void collect_lights(std::vector<light_info>&) const {}
+
+    // Where r enters and leaves the shape, for closed shapes used as medium boundaries.
+    // Convex shapes answer this in one query; the fallback intersects twice.
+    virtual bool hit_interval(const ray& r, float& t_enter, float& t_exit) const {
+        hit_record rec1, rec2;
+        if(!hit(r, -f_infinity, f_infinity, rec1))
+            return false;
+        if(!hit(r, rec1.t + .0001f, f_infinity, rec2))
+            return false;
+        t_enter = rec1.t;
+        t_exit = rec2.t;
+        return true;
+    }
 };
 
 class translate : public hittable {
@@ -44,6 +77,28 @@ public:
 
     bool bounding_box(float time0, float time1, aabb& output_box) const override;
 
+    [[nodiscard]] float pdf_value(const point3& o, const vec3& v) const override {
+        return ptr->pdf_value(o - offset, v);
+    }
+
+    [[nodiscard]] vec3 random(const point3& o) const override {
+        return ptr->random(o - offset);
+    }
+
+    bool hit_interval(const ray& r, float& t_enter, float& t_exit) const override {
+        return ptr->hit_interval(ray(r.origin() - offset, r.direction(), r.time()), t_enter, t_exit);
+    }
+
+    void collect_lights(std::vector<light_info>& lights) const override {
+        // Only a single translated shape can be sampled through this wrapper
+        std::vector<light_info> inner;
+        ptr->collect_lights(inner);
+        if(inner.size() != 1 || inner[0].obj != ptr.get()) return;
+        inner[0].obj = this;
+        inner[0].box = aabb(inner[0].box.min() + offset, inner[0].box.max() + offset);
+        lights.push_back(inner[0]);
+    }
+
 public:
     shared_ptr<hittable> ptr;
     vec3 offset;
@@ -56,6 +111,7 @@ bool translate::hit(const ray& r, float t_min, float t_max, hit_record& rec) con
 
     rec.p += offset;
     rec.set_face_normal(moved_r, rec.normal);
+    if(rec.obj == ptr.get()) rec.obj = this;
 
     return true;
 }
@@ -80,6 +136,7 @@ public:
             return false;
 
         rec.front_face = !rec.front_face;
+        if(rec.obj == ptr.get()) rec.obj = this;
         return true;
     }
 
@@ -87,6 +144,28 @@ public:
         return ptr->bounding_box(time0, time1, output_box);
     }
 
+    [[nodiscard]] float pdf_value(const point3& o, const vec3& v) const override {
+        return ptr->pdf_value(o, v);
+    }
+
+    [[nodiscard]] vec3 random(const point3& o) const override {
+        return ptr->random(o);
+    }
+
+    bool hit_interval(const ray& r, float& t_enter, float& t_exit) const override {
+        return ptr->hit_interval(r, t_enter, t_exit);
+    }
+
+    void collect_lights(std::vector<light_info>& lights) const override {
+        // A flipped shape emits from its other side
+        std::vector<light_info> inner;
+        ptr->collect_lights(inner);
+        if(inner.size() != 1 || inner[0].obj != ptr.get()) return;
+        inner[0].obj = this;
+        inner[0].axis = -inner[0].axis;
+        lights.push_back(inner[0]);
+    }
+
 public:
     shared_ptr<hittable> ptr;
 };
@@ -25,6 +25,10 @@ public:
 
     bool bounding_box(float time0, float time1, aabb& output_box) const override;
 
+    void collect_lights(std::vector<light_info>& lights) const override {
+        for(const auto& object : objects) object->collect_lights(lights);
+    }
+
 public:
     std::vector<shared_ptr<hittable>> objects;
 };
@@ -62,6 +62,10 @@ public:
         return false;
     }
 
+    void collect_lights(std::vector<light_info>& lights) const override {
+        for(const triangle& f : faces) f.collect_lights(lights);
+    }
+
 public:
     shared_ptr<material> mat_ptr;
     std::vector<vec3> vertices;
@@ -69,24 +73,18 @@ public:
 };
 
 bool mesh::hit(const ray &r, float t_min, float t_max, hit_record &rec) const {
-    vec3 normal(0,0,0);
-    float thit = 10000000.0f;
+    hit_record temp_rec;
     bool hit = false;
+    auto closest_so_far = t_max;
 
     for(const triangle& f : faces) {
-        if(f.hit(r, t_min, t_max, rec)) {
-            if(rec.t < thit) {
-                thit = rec.t;
-                normal = rec.normal;
-            }
+        if(f.hit(r, t_min, closest_so_far, temp_rec)) {
+            closest_so_far = temp_rec.t;
+            rec = temp_rec;
             hit = true;
         }
     }
 
-    rec.t = thit;
-    rec.normal = normal;
-    rec.p = r.at(rec.t);
-
     return hit;
 }
 
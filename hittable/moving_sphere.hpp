@@ -54,6 +54,7 @@ bool moving_sphere::hit(const ray& r, float t_min, float t_max, hit_record& rec)
     auto outward_normal = (rec.p - center(r.time())) / radius;
     rec.set_face_normal(r, outward_normal);
     rec.mat_ptr = mat_ptr;
+    rec.obj = this;
 
     return true;
 }
@@ -31,6 +31,7 @@ public:
         auto outward_normal = vec3(0, 0, 1);
         rec.set_face_normal(r, outward_normal);
         rec.mat_ptr = mp;
+        rec.obj = this;
         rec.p = r.at(t);
         return true;
     }
@@ -41,6 +42,28 @@ public:
         return true;
     }
 
+    [[nodiscard]] float pdf_value(const point3& origin, const vec3& v) const override {
+        hit_record rec;
+        if(!this->hit(ray(origin, v), 0.001f, f_infinity, rec))
+            return 0;
+
+        const auto area = (x1-x0)*(y1-y0);
+        const auto distance_squared = rec.t * rec.t * v.length_squared();
+        const auto cosine = fabs(dot(v, rec.normal) / v.length());
+        return distance_squared / (cosine * area);
+    }
+
+    [[nodiscard]] vec3 random(const point3& origin) const override {
+        const auto random_point = point3(random_float(x0, x1), random_float(y0, y1), k);
+        return random_point - origin;
+    }
+
+    void collect_lights(std::vector<light_info>& lights) const override {
+        aabb box;
+        bounding_box(0, 0, box);
+        lights.push_back({this, box, vec3(0, 0, 1), 1.0f, (x1-x0)*(y1-y0), mp});
+    }
+
 public:
     shared_ptr<material> mp;
     float x0{}, x1{}, y0{}, y1{}, k{};
@@ -68,16 +91,39 @@ public:
         auto outward_normal = vec3(0, 1, 0);
         rec.set_face_normal(r, outward_normal);
         rec.mat_ptr = mp;
+        rec.obj = this;
         rec.p = r.at(t);
         return true;
     }
 
     bool bounding_box(float time0, float time1, aabb& output_box) const override {
-        // The bounding box must have non-zero width in each dimension, so pad the Z dimension a small amount
-        output_box = aabb(point3(x0, z0, k-.0001f), point3(x1, z1, k+.0001f));
+        // The bounding box must have non-zero width in each dimension, so pad the Y dimension a small amount
+        output_box = aabb(point3(x0, k-.0001f, z0), point3(x1, k+.0001f, z1));
         return true;
     }
 
+    [[nodiscard]] float pdf_value(const point3& origin, const vec3& v) const override {
+        hit_record rec;
+        if(!this->hit(ray(origin, v), 0.001f, f_infinity, rec))
+            return 0;
+
+        const auto area = (x1-x0)*(z1-z0);
+        const auto distance_squared = rec.t * rec.t * v.length_squared();
+        const auto cosine = fabs(dot(v, rec.normal) / v.length());
+        return distance_squared / (cosine * area);
+    }
+
+    [[nodiscard]] vec3 random(const point3& origin) const override {
+        const auto random_point = point3(random_float(x0, x1), k, random_float(z0, z1));
+        return random_point - origin;
+    }
+
+    void collect_lights(std::vector<light_info>& lights) const override {
+        aabb box;
+        bounding_box(0, 0, box);
+        lights.push_back({this, box, vec3(0, 1, 0), 1.0f, (x1-x0)*(z1-z0), mp});
+    }
+
 public:
     shared_ptr<material> mp;
     float x0{}, x1{}, z0{}, z1{}, k{};
@@ -105,16 +151,39 @@ public:
         auto outward_normal = vec3(1, 0, 0);
         rec.set_face_normal(r, outward_normal);
         rec.mat_ptr = mp;
+        rec.obj = this;
         rec.p = r.at(t);
         return true;
     }
 
     bool bounding_box(float time0, float time1, aabb& output_box) const override {
-        // The bounding box must have non-zero width in each dimension, so pad the Z dimension a small amount
-        output_box = aabb(point3(y0, z0, k-.0001f), point3(y1, z1, k+.0001f));
+        // The bounding box must have non-zero width in each dimension, so pad the X dimension a small amount
+        output_box = aabb(point3(k-.0001f, y0, z0), point3(k+.0001f, y1, z1));
         return true;
     }
 
+    [[nodiscard]] float pdf_value(const point3& origin, const vec3& v) const override {
+        hit_record rec;
+        if(!this->hit(ray(origin, v), 0.001f, f_infinity, rec))
+            return 0;
+
+        const auto area = (y1-y0)*(z1-z0);
+        const auto distance_squared = rec.t * rec.t * v.length_squared();
+        const auto cosine = fabs(dot(v, rec.normal) / v.length());
+        return distance_squared / (cosine * area);
+    }
+
+    [[nodiscard]] vec3 random(const point3& origin) const override {
+        const auto random_point = point3(k, random_float(y0, y1), random_float(z0, z1));
+        return random_point - origin;
+    }
+
+    void collect_lights(std::vector<light_info>& lights) const override {
+        aabb box;
+        bounding_box(0, 0, box);
+        lights.push_back({this, box, vec3(1, 0, 0), 1.0f, (y1-y0)*(z1-z0), mp});
+    }
+
 public:
     shared_ptr<material> mp;
     float y0{}, y1{}, z0{}, z1{}, k{};
@@ -21,6 +21,18 @@ public:
 
     bool bounding_box(float time0, float time1, aabb& output_box) const override;
 
+    [[nodiscard]] float pdf_value(const point3& o, const vec3& v) const override;
+
+    bool hit_interval(const ray& r, float& t_enter, float& t_exit) const override;
+
+    [[nodiscard]] vec3 random(const point3& o) const override;
+
+    void collect_lights(std::vector<light_info>& lights) const override {
+        aabb box;
+        bounding_box(0, 0, box);
+        lights.push_back({this, box, vec3(0, 1, 0), -1.0f, 4*fpi*radius*radius, mat_ptr});
+    }
+
 private:
     point3 center;
     float radius;
@@ -77,10 +89,50 @@ bool sphere::hit(const ray& r, float t_min, float t_max, hit_record& rec) const
     rec.set_face_normal(r, outward_normal);
     get_sphere_uv(outward_normal, rec.u, rec.v);
     rec.mat_ptr = mat_ptr;
+    rec.obj = this;
 
     return true;
 };
 
+bool sphere::hit_interval(const ray& r, float& t_enter, float& t_exit) const {
+    // Both roots of the same quadratic hit() solves
+    vec3 oc = r.origin() - center;
+    auto a = r.direction().length_squared();
+    auto half_b = dot(oc, r.direction());
+    auto c = oc.length_squared() - radius*radius;
+
+    auto discriminant = half_b*half_b - a*c;
+    if(discriminant <= 0) return false;
+    auto sqrtd = sqrt(discriminant);
+
+    t_enter = (-half_b - sqrtd) / a;
+    t_exit = (-half_b + sqrtd) / a;
+    return true;
+}
+
+float sphere::pdf_value(const point3& o, const vec3& v) const {
+    // Uniform over the cone of directions the sphere subtends from o
+    hit_record rec;
+    const float distance_squared = (center - o).length_squared();
+    if(distance_squared <= radius*radius || !this->hit(ray(o, v), 0.001f, f_infinity, rec))
+        return 0;
+
+    const float cos_theta_max = sqrtf(1 - radius*radius/distance_squared);
+    const float solid_angle = 2*fpi*(1 - cos_theta_max);
+    return 1 / solid_angle;
+}
+
+vec3 sphere::random(const point3& o) const {
+    const vec3 direction = center - o;
+    const float distance_squared = direction.length_squared();
+    if(distance_squared <= radius*radius)
+        return random_unit_vector();
+
+    onb uvw;
+    uvw.build_from_w(direction);
+    return uvw.local(random_to_sphere(radius, distance_squared));
+}
+
 bool sphere::bounding_box(float time0, float time1, aabb &output_box) const {
     output_box = aabb(
             center - vec3(radius, radius, radius),
@@ -18,6 +18,33 @@ public:
     bool hit(const ray& r, float t_min, float t_max, hit_record& rec) const override;
     bool bounding_box(float t0, float t1, aabb& output_box) const override;
 
+    [[nodiscard]] float pdf_value(const point3& o, const vec3& v) const override {
+        hit_record rec;
+        if(!this->hit(ray(o, v), 0.001f, f_infinity, rec))
+            return 0;
+
+        const auto distance_squared = rec.t * rec.t * v.length_squared();
+        const auto cosine = fabs(dot(v, rec.normal) / v.length());
+        return distance_squared / (cosine * area());
+    }
+
+    [[nodiscard]] vec3 random(const point3& o) const override {
+        // Uniform point on the triangle from folded barycentrics
+        float a = random_float(), b = random_float();
+        if(a + b > 1) { a = 1 - a; b = 1 - b; }
+        return v1 + a*e1 + b*e2 - o;
+    }
+
+    void collect_lights(std::vector<light_info>& lights) const override {
+        aabb box;
+        bounding_box(0, 0, box);
+        lights.push_back({this, box, unit_vector(cross(e1, e2)), 1.0f, area(), mat_ptr});
+    }
+
+    [[nodiscard]] float area() const {
+        return .5f * cross(e1, e2).length();
+    }
+
     vec3 get_midpoint() {
         return (v1 + v2 + v3)/3;
     }
@@ -94,6 +121,7 @@ bool triangle::hit(const ray &r, float t_min, float t_max, hit_record &rec) cons
         vec3 outward_normal = unit_vector(cross(e1, e2));
         rec.set_face_normal(r, outward_normal);
         rec.mat_ptr = mat_ptr;
+        rec.obj = this;
         return true;
     }
 
@@ -8,6 +8,7 @@
 #include "timer.hpp"
 #include "raytracer.hpp"
 #include "scenes.hpp"
+#include "parallel/image_output.hpp"
 
 #include <iostream>
 
@@ -21,12 +22,12 @@ int main() {
     const int max_depth = 16;
 
     // World
-    auto world = mesh_test();
+    scene scn{mesh_test()};
+    scn.build_lights();
 
     // Camera
 
 //    point3 lookfrom(13, 2, 3);
-    color background = color(0,0,0);
     point3 lookfrom = point3(0, 4, -3);
     point3 lookat(0,0,0);
     vec3 vup(0,1,0);
@@ -37,23 +38,21 @@ int main() {
 
     // Render
     Timer timer;
-    std::cout << "P3\n" << image_width << " " << image_height << "\n255\n";
-
+    frame_planes image(image_width, image_height);
     for(int j = image_height-1; j >= 0; --j) {
         std::cerr << "\rScanlines remaining: " << j << " " << std::flush;
         for(int i = 0; i < image_width; ++i) {
-            color pixel_color(0, 0, 0);
             for(int s = 0; s < samples_per_pixel; ++s) {
                 auto u = (i + random_float()) / (image_width-1);
                 auto v = (j + random_float()) / (image_height-1);
                 ray r = cam.get_ray(u, v);
-                pixel_color += ray_color2(r, background, &world, max_depth);
+                image.add(i, j, ray_color2(r, scn, max_depth));
             }
-            write_color(std::cout, pixel_color, samples_per_pixel);
         }
     }
     std::cerr << "\nFinished rendering in " << timer.get_millis() << " ms or "
               << timer.get_seconds() << "s. ";
+    if(!write_image("image.ppm", image)) std::cerr << "\nCouldn't write image.ppm";
     std::cerr << "\nDone\n";
     return 0;
 }
@@ -39,33 +39,29 @@ bool constant_medium::hit(const ray& r, float t_min, float t_max, hit_record& re
     const bool enableDebug = false;
     const bool debugging = enableDebug && random_float() < 0.00001;
 
-    hit_record rec1, rec2;
-
-    if (!boundary->hit(r, -infinity, infinity, rec1))
-        return false;
-
-    if (!boundary->hit(r, rec1.t+0.0001, infinity, rec2))
+    float t_enter, t_exit;
+    if (!boundary->hit_interval(r, t_enter, t_exit))
         return false;
 
-    if (debugging) std::cerr << "\nt_min=" << rec1.t << ", t_max=" << rec2.t << '\n';
+    if (debugging) std::cerr << "\nt_min=" << t_enter << ", t_max=" << t_exit << '\n';
 
-    if (rec1.t < t_min) rec1.t = t_min;
-    if (rec2.t > t_max) rec2.t = t_max;
+    if (t_enter < t_min) t_enter = t_min;
+    if (t_exit > t_max) t_exit = t_max;
 
-    if (rec1.t >= rec2.t)
+    if (t_enter >= t_exit)
         return false;
 
-    if (rec1.t < 0)
-        rec1.t = 0;
+    if (t_enter < 0)
+        t_enter = 0;
 
     const auto ray_length = r.direction().length();
-    const auto distance_inside_boundary = (rec2.t - rec1.t) * ray_length;
+    const auto distance_inside_boundary = (t_exit - t_enter) * ray_length;
     const auto hit_distance = neg_inv_density * log(random_float());
 
     if (hit_distance > distance_inside_boundary)
         return false;
 
-    rec.t = rec1.t + hit_distance / ray_length;
+    rec.t = t_enter + hit_distance / ray_length;
     rec.p = r.at(rec.t);
 
     if (debugging) {
@@ -77,6 +73,7 @@ bool constant_medium::hit(const ray& r, float t_min, float t_max, hit_record& re
     rec.normal = vec3(1,0,0);  // arbitrary
     rec.front_face = true;     // also arbitrary
     rec.mat_ptr = phase_function;
+    rec.obj = this;
 
     return true;
 }
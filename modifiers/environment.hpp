@@ -0,0 +1,150 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#ifndef RAYTRACING_ENVIRONMENT_HPP
+#define RAYTRACING_ENVIRONMENT_HPP
+
+#include <string>
+#include <vector>
+
+#include "rtweekend.hpp"
+#include "color.hpp"
+#include "rtw_stb_image.hpp"
+#include "sampling/distribution.hpp"
+
+class float_image {
+    // Linear float RGB image; 8-bit files are converted from sRGB by stb
+public:
+    float_image() = default;
+    explicit float_image(const std::string& filename) {
+        int components = 3;
+        float* raw = stbi_loadf(filename.c_str(), &width, &height, &components, 3);
+        if(!raw) {
+            std::cerr << "ERROR: Could not load environment image file " << filename << std::endl;
+            width = height = 0;
+            return;
+        }
+        pixels.assign(raw, raw + width * height * 3);
+        stbi_image_free(raw);
+    }
+
+    [[nodiscard]] color texel(float u, float v) const {
+        // u, v in [0,1], v = 0 is the top row
+        if(pixels.empty())
+            return color(0,1,1);
+        const int i = std::min(int(u * (float)width), width - 1);
+        const int j = std::min(int(v * (float)height), height - 1);
+        const float* p = &pixels[(j * width + i) * 3];
+        return color(p[0], p[1], p[2]);
+    }
+
+    int width{}, height{};
+
+private:
+    std::vector<float> pixels;
+};
+
+class environment {
+    // Distant light looked up by direction when a ray escapes the scene. Either an
+    // equirectangular map or a cube map; both are importance sampled through a
+    // piecewise-constant distribution over a latitude-longitude grid.
+public:
+    environment(const std::string& equirect, float s = 1.0f) : scale{s} {
+        faces.emplace_back(equirect);
+        build_distribution(std::max(faces[0].width, 1), std::max(faces[0].height, 1));
+    }
+
+    // Cube map faces in posx, negx, posy, negy, posz, negz order
+    environment(const std::vector<std::string>& cube_faces, float s = 1.0f) : scale{s} {
+        for(const auto& f : cube_faces) faces.emplace_back(f);
+        build_distribution(512, 256);
+    }
+
+    [[nodiscard]] color value(const vec3& dir) const {
+        if(faces.size() == 1) {
+            float u, v;
+            get_equirect_uv(dir, u, v);
+            return scale * faces[0].texel(u, v);
+        }
+        return scale * cube_value(dir);
+    }
+
+    [[nodiscard]] vec3 sample(float& pdf) const {
+        // Pick a grid cell, then a uniform point in it; pdf is with respect to solid angle
+        int i, j;
+        float pmf;
+        dist.sample(random_float(), random_float(), i, j, pmf);
+        const float phi = ((float)i + random_float()) / (float)dist.width * 2*fpi;
+        const float theta = ((float)j + random_float()) / (float)dist.height * fpi;
+        const float sin_theta = sinf(theta);
+        pdf = sin_theta > 0 ? pmf * (float)(dist.width * dist.height) / (2*fpi*fpi * sin_theta) : 0;
+        return vec3(-cosf(phi) * sin_theta, cosf(theta), -sinf(phi) * sin_theta);
+    }
+
+    [[nodiscard]] float pdf(const vec3& dir) const {
+        float u, v;
+        get_equirect_uv(dir, u, v);
+        const float sin_theta = sinf(v * fpi);
+        if(sin_theta <= 0) return 0;
+        const int i = std::min(int(u * (float)dist.width), dist.width - 1);
+        const int j = std::min(int(v * (float)dist.height), dist.height - 1);
+        return dist.pmf(i, j) * (float)(dist.width * dist.height) / (2*fpi*fpi * sin_theta);
+    }
+
+private:
+    std::vector<float_image> faces;
+    distribution_2d dist;
+    float scale;
+
+    static void get_equirect_uv(const vec3& d, float& u, float& v) {
+        // u: angle around the Y axis from -X, v: angle from +Y (top row) to -Y
+        const vec3 n = unit_vector(d);
+        u = (atan2f(n.z(), n.x()) + fpi) / (2*fpi);
+        v = acosf(fclamp(n.y(), -1, 1)) / fpi;
+    }
+
+    [[nodiscard]] color cube_value(const vec3& d) const {
+        // Standard cube map face selection; images are stored top row first
+        const float ax = fabsf(d.x()), ay = fabsf(d.y()), az = fabsf(d.z());
+        int face;
+        float sc, tc, ma;
+        if(ax >= ay && ax >= az) {
+            face = d.x() > 0 ? 0 : 1;
+            sc = d.x() > 0 ? -d.z() : d.z();
+            tc = -d.y();
+            ma = ax;
+        }
+        else if(ay >= az) {
+            face = d.y() > 0 ? 2 : 3;
+            sc = d.x();
+            tc = d.y() > 0 ? d.z() : -d.z();
+            ma = ay;
+        }
+        else {
+            face = d.z() > 0 ? 4 : 5;
+            sc = d.z() > 0 ? d.x() : -d.x();
+            tc = -d.y();
+            ma = az;
+        }
+        if(face >= (int)faces.size())
+            return color(0,0,0);
+        return faces[face].texel(fclamp(.5f * (sc / ma + 1), 0, 1), fclamp(.5f * (tc / ma + 1), 0, 1));
+    }
+
+    void build_distribution(int w, int h) {
+        // Luminance times sin(theta), so cells near the poles are not over-sampled
+        std::vector<float> weights(w * h);
+        for(int j=0; j < h; ++j) {
+            const float theta = ((float)j + .5f) / (float)h * fpi;
+            for(int i=0; i < w; ++i) {
+                const float phi = ((float)i + .5f) / (float)w * 2*fpi;
+                const vec3 dir(-cosf(phi) * sinf(theta), cosf(theta), -sinf(phi) * sinf(theta));
+                weights[j * w + i] = luminance(value(dir)) * sinf(theta);
+            }
+        }
+        dist = distribution_2d(weights, w, h);
+    }
+};
+
+#endif //RAYTRACING_ENVIRONMENT_HPP
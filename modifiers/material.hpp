@@ -31,6 +31,10 @@ public:
     [[nodiscard]] virtual float scattering_pdf(const ray& r_in, const hit_record& rec, const ray& scattered) const {
         return 0;
     }
+    [[nodiscard]] virtual color emission() const {
+        // Rough average of emitted radiance, used to estimate light power
+        return color(0,0,0);
+    }
 };
 
 class lambertian : public material {
@@ -130,6 +134,10 @@ public:
             return color(0,0,0);
     }
 
+    [[nodiscard]] color emission() const override {
+        return emit->value(.5f, .5f, point3(0,0,0));
+    }
+
 public:
     shared_ptr<texture> emit;
 };
@@ -142,8 +150,13 @@ public:
     bool scatter(const ray& r_in, const hit_record& rec, scatter_record& srec) const override {
         srec.specular_ray = ray(rec.p, random_in_unit_sphere(), r_in.time());
         srec.attenuation = albedo->value(rec.u, rec.v, rec.p);
+        srec.is_specular = false;
+        srec.pdf = 1 / (4*fpi);
         return true;
     }
+    [[nodiscard]] float scattering_pdf(const ray&, const hit_record&, const ray&) const override {
+        return 1 / (4*fpi);
+    }
 
 public:
     shared_ptr<texture> albedo;
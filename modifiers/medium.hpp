@@ -0,0 +1,274 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#ifndef RAYTRACING_MEDIUM_HPP
+#define RAYTRACING_MEDIUM_HPP
+
+#include <utility>
+#include <vector>
+
+#include "rtweekend.hpp"
+#include "hittable/aabb.hpp"
+#include "hittable/hittable.hpp"
+#include "modifiers/material.hpp"
+
+class medium {
+    // Participating medium handled by the integrator rather than as a hittable, so that
+    // shadow rays can estimate transmittance through it.
+public:
+    explicit medium(const color& a) : albedo{a}, phase_function(make_shared<isotropic>(a)) {}
+    virtual ~medium() = default;
+
+    // The part of (t_min, t_max) where r is inside the medium
+    virtual bool interval(const ray&, float t_min, float t_max, float& t0, float& t1) const {
+        t0 = t_min;
+        t1 = t_max;
+        return t0 < t1;
+    }
+
+    // Extinction per unit length at p
+    [[nodiscard]] virtual float extinction(const point3& p) const = 0;
+
+    // True if extinction is constant inside the medium and transmittance() is exact, which lets
+    // the integrator evaluate distance sampling pdfs for MIS
+    [[nodiscard]] virtual bool analytic() const { return false; }
+
+    // Free-flight sampling: true if r has a real collision in (t_min, t_max), stored in t
+    virtual bool sample_distance(const ray& r, float t_min, float t_max, float& t) const = 0;
+
+    // Unbiased estimate of the transmittance of r between t_min and t_max
+    [[nodiscard]] virtual float transmittance(const ray& r, float t_min, float t_max) const = 0;
+
+public:
+    color albedo;
+    shared_ptr<material> phase_function;
+};
+
+class homogeneous_medium : public medium {
+    // Constant density, either filling all of space (global fog) or inside a closed boundary
+    // shape. Free flights and transmittance are analytic.
+public:
+    homogeneous_medium(float density, const color& albedo, shared_ptr<hittable> b = nullptr)
+            : medium(albedo), sigma_t{density}, boundary(std::move(b)) {}
+
+    bool interval(const ray& r, float t_min, float t_max, float& t0, float& t1) const override {
+        t0 = t_min;
+        t1 = t_max;
+        float t_enter, t_exit;
+        if(boundary) {
+            if(!boundary->hit_interval(r, t_enter, t_exit))
+                return false;
+            t0 = fmax(t0, t_enter);
+            t1 = fmin(t1, t_exit);
+        }
+        return t0 < t1;
+    }
+
+    [[nodiscard]] float extinction(const point3&) const override { return sigma_t; }
+
+    [[nodiscard]] bool analytic() const override { return true; }
+
+    bool sample_distance(const ray& r, float t_min, float t_max, float& t) const override {
+        float t0, t1;
+        if(!interval(r, t_min, t_max, t0, t1))
+            return false;
+        t = t0 - logf(1 - random_float()) / (sigma_t * r.direction().length());
+        return t < t1;
+    }
+
+    [[nodiscard]] float transmittance(const ray& r, float t_min, float t_max) const override {
+        float t0, t1;
+        if(!interval(r, t_min, t_max, t0, t1))
+            return 1;
+        return expf(-sigma_t * r.direction().length() * (t1 - t0));
+    }
+
+private:
+    float sigma_t;
+    shared_ptr<hittable> boundary;
+};
+
+class grid_medium : public medium {
+    // Heterogeneous medium from a dense nx*ny*nz density grid spanning bounds. A coarse grid of
+    // per-cell maximum densities lets delta and ratio tracking take long steps through thin
+    // regions and skip empty cells entirely.
+public:
+    grid_medium(const aabb& b, int _nx, int _ny, int _nz, std::vector<float> d, float sigma,
+                const color& albedo, int majorant_res = 16)
+            : medium(albedo), bounds{b}, nx{_nx}, ny{_ny}, nz{_nz}, density_grid(std::move(d)), sigma_t{sigma},
+              mx{std::min(majorant_res, _nx)}, my{std::min(majorant_res, _ny)}, mz{std::min(majorant_res, _nz)}
+    {
+        build_majorants();
+    }
+
+    [[nodiscard]] float density(const point3& p) const;
+
+    bool interval(const ray& r, float t_min, float t_max, float& t0, float& t1) const override {
+        t0 = t_min;
+        t1 = t_max;
+        return bounds.hit(r, t0, t1);
+    }
+
+    [[nodiscard]] float extinction(const point3& p) const override { return sigma_t * density(p); }
+
+    bool sample_distance(const ray& r, float t_min, float t_max, float& t) const override;
+
+    [[nodiscard]] float transmittance(const ray& r, float t_min, float t_max) const override;
+
+private:
+    aabb bounds;
+    int nx, ny, nz;
+    std::vector<float> density_grid;
+    float sigma_t; // extinction at density 1, per unit length
+    int mx, my, mz;
+    std::vector<float> majorants;
+
+    [[nodiscard]] float voxel(int i, int j, int k) const {
+        i = std::clamp(i, 0, nx - 1);
+        j = std::clamp(j, 0, ny - 1);
+        k = std::clamp(k, 0, nz - 1);
+        return density_grid[(k * ny + j) * nx + i];
+    }
+
+    void build_majorants();
+
+    template<typename F>
+    void traverse(const ray& r, float t_min, float t_max, F&& visit) const;
+};
+
+float grid_medium::density(const point3& p) const {
+    // Trilinear interpolation between voxel centers
+    const vec3 size = bounds.max() - bounds.min();
+    const float gx = (p.x() - bounds.min().x()) / size.x() * (float)nx - .5f;
+    const float gy = (p.y() - bounds.min().y()) / size.y() * (float)ny - .5f;
+    const float gz = (p.z() - bounds.min().z()) / size.z() * (float)nz - .5f;
+    const int i = (int)floorf(gx), j = (int)floorf(gy), k = (int)floorf(gz);
+    const float u = gx - (float)i, v = gy - (float)j, w = gz - (float)k;
+
+    float d = 0;
+    for(int di=0; di < 2; ++di)
+        for(int dj=0; dj < 2; ++dj)
+            for(int dk=0; dk < 2; ++dk)
+                d += (di ? u : 1-u) * (dj ? v : 1-v) * (dk ? w : 1-w) * voxel(i+di, j+dj, k+dk);
+    return d;
+}
+
+void grid_medium::build_majorants() {
+    // Interpolation reads one voxel past a cell's own, so each cell bounds its voxels plus a border
+    majorants.assign(mx * my * mz, 0);
+    for(int c=0; c < mz; ++c) {
+        for(int b=0; b < my; ++b) {
+            for(int a=0; a < mx; ++a) {
+                float m = 0;
+                for(int k = c*nz/mz - 1; k <= (c+1)*nz/mz; ++k)
+                    for(int j = b*ny/my - 1; j <= (b+1)*ny/my; ++j)
+                        for(int i = a*nx/mx - 1; i <= (a+1)*nx/mx; ++i)
+                            m = fmax(m, voxel(i, j, k));
+                majorants[(c * my + b) * mx + a] = m;
+            }
+        }
+    }
+}
+
+template<typename F>
+void grid_medium::traverse(const ray& r, float t_min, float t_max, F&& visit) const {
+    // 3D DDA over the majorant grid. visit(t0, t1, majorant) gets each cell's segment with the
+    // majorant already scaled to extinction per unit of t, and returns false to stop.
+    float t0 = t_min, t1 = t_max;
+    if(!bounds.hit(r, t0, t1))
+        return;
+
+    const int res[3] = {mx, my, mz};
+    const vec3 size = bounds.max() - bounds.min();
+    const float len = r.direction().length();
+    const point3 entry = r.at(t0);
+
+    int cell[3], step[3];
+    float next[3], delta[3];
+    for(int a=0; a < 3; ++a) {
+        const float cell_size = size[a] / (float)res[a];
+        const float g = (entry[a] - bounds.min()[a]) / cell_size;
+        const float d = r.direction()[a] / cell_size;
+        cell[a] = std::clamp((int)floorf(g), 0, res[a] - 1);
+        if(d > 0) {
+            step[a] = 1;
+            next[a] = t0 + ((float)(cell[a] + 1) - g) / d;
+            delta[a] = 1 / d;
+        }
+        else if(d < 0) {
+            step[a] = -1;
+            next[a] = t0 + ((float)cell[a] - g) / d;
+            delta[a] = -1 / d;
+        }
+        else {
+            step[a] = 0;
+            next[a] = delta[a] = f_infinity;
+        }
+    }
+
+    float t = t0;
+    while(t < t1) {
+        const int a = next[0] < next[1] ? (next[0] < next[2] ? 0 : 2) : (next[1] < next[2] ? 1 : 2);
+        const float tb = fmin(next[a], t1);
+        const float majorant = majorants[(cell[2] * my + cell[1]) * mx + cell[0]] * sigma_t * len;
+        if(!visit(t, tb, majorant))
+            return;
+
+        t = tb;
+        cell[a] += step[a];
+        if(cell[a] < 0 || cell[a] >= res[a])
+            return;
+        next[a] += delta[a];
+    }
+}
+
+bool grid_medium::sample_distance(const ray& r, float t_min, float t_max, float& t) const {
+    // Delta tracking: tentative collisions against the cell majorant, accepted as real with
+    // probability density / majorant
+    const float len = r.direction().length();
+    bool scattered = false;
+    traverse(r, t_min, t_max, [&](float ta, float tb, float majorant) {
+        if(majorant <= 0)
+            return true;
+        float tt = ta;
+        while(true) {
+            tt -= logf(1 - random_float()) / majorant;
+            if(tt >= tb)
+                return true;
+            if(random_float() * majorant < sigma_t * len * density(r.at(tt))) {
+                t = tt;
+                scattered = true;
+                return false;
+            }
+        }
+    });
+    return scattered;
+}
+
+float grid_medium::transmittance(const ray& r, float t_min, float t_max) const {
+    // Ratio tracking, with Russian roulette once the estimate gets small
+    const float len = r.direction().length();
+    float tr = 1;
+    traverse(r, t_min, t_max, [&](float ta, float tb, float majorant) {
+        if(majorant <= 0)
+            return true;
+        float tt = ta;
+        while(true) {
+            tt -= logf(1 - random_float()) / majorant;
+            if(tt >= tb)
+                return true;
+            tr *= 1 - sigma_t * len * density(r.at(tt)) / majorant;
+            if(tr < .1f) {
+                if(random_float() >= .5f) {
+                    tr = 0;
+                    return false;
+                }
+                tr *= 2;
+            }
+        }
+    });
+    return tr;
+}
+
+#endif //RAYTRACING_MEDIUM_HPP
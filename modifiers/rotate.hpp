@@ -15,6 +15,10 @@ public:
 
     bool hit(const ray& r, float t_min, float t_max, hit_record& rec) const override;
 
+    bool hit_interval(const ray& r, float& t_enter, float& t_exit) const override {
+        return ptr->hit_interval(to_object(r), t_enter, t_exit);
+    }
+
     bool bounding_box(float time0, float time1, aabb& output_box) const override {
         output_box = bbox;
         return hasbox;
@@ -26,6 +30,9 @@ public:
     float cos_theta;
     bool hasbox;
     aabb bbox;
+
+private:
+    [[nodiscard]] ray to_object(const ray& r) const;
 };
 
 rotate_y::rotate_y(shared_ptr<hittable> p, float angle) : ptr(std::move(p)) {
@@ -60,7 +67,7 @@ rotate_y::rotate_y(shared_ptr<hittable> p, float angle) : ptr(std::move(p)) {
     bbox = aabb(min, max);
 }
 
-bool rotate_y::hit(const ray& r, float t_min, float t_max, hit_record& rec) const {
+ray rotate_y::to_object(const ray& r) const {
     auto origin = r.origin();
     auto direction = r.direction();
 
@@ -70,7 +77,11 @@ bool rotate_y::hit(const ray& r, float t_min, float t_max, hit_record& rec) cons
     direction[0] = cos_theta*r.direction()[0] - sin_theta*r.direction()[2];
     direction[2] = sin_theta*r.direction()[0] + cos_theta*r.direction()[2];
 
-    ray rotated_r(origin, direction, r.time());
+    return ray(origin, direction, r.time());
+}
+
+bool rotate_y::hit(const ray& r, float t_min, float t_max, hit_record& rec) const {
+    ray rotated_r = to_object(r);
 
     if (!ptr->hit(rotated_r, t_min, t_max, rec))
         return false;
@@ -96,6 +107,10 @@ public:
 
     bool hit(const ray& r, float t_min, float t_max, hit_record& rec) const override;
 
+    bool hit_interval(const ray& r, float& t_enter, float& t_exit) const override {
+        return ptr->hit_interval(to_object(r), t_enter, t_exit);
+    }
+
     bool bounding_box(float time0, float time1, aabb& output_box) const override {
         output_box = bbox;
         return hasbox;
@@ -107,6 +122,9 @@ public:
     float cos_theta;
     bool hasbox;
     aabb bbox;
+
+private:
+    [[nodiscard]] ray to_object(const ray& r) const;
 };
 
 rotate_x::rotate_x(shared_ptr<hittable> p, float angle) : ptr(std::move(p)) {
@@ -141,7 +159,7 @@ rotate_x::rotate_x(shared_ptr<hittable> p, float angle) : ptr(std::move(p)) {
     bbox = aabb(min, max);
 }
 
-bool rotate_x::hit(const ray& r, float t_min, float t_max, hit_record& rec) const {
+ray rotate_x::to_object(const ray& r) const {
     auto origin = r.origin();
     auto direction = r.direction();
 
@@ -151,7 +169,11 @@ bool rotate_x::hit(const ray& r, float t_min, float t_max, hit_record& rec) cons
     direction[1] = cos_theta*r.direction()[1] - sin_theta*r.direction()[2];
     direction[2] = sin_theta*r.direction()[1] + cos_theta*r.direction()[2];
 
-    ray rotated_r(origin, direction, r.time());
+    return ray(origin, direction, r.time());
+}
+
+bool rotate_x::hit(const ray& r, float t_min, float t_max, hit_record& rec) const {
+    ray rotated_r = to_object(r);
 
     if (!ptr->hit(rotated_r, t_min, t_max, rec))
         return false;
@@ -177,6 +199,10 @@ public:
 
     bool hit(const ray& r, float t_min, float t_max, hit_record& rec) const override;
 
+    bool hit_interval(const ray& r, float& t_enter, float& t_exit) const override {
+        return ptr->hit_interval(to_object(r), t_enter, t_exit);
+    }
+
     bool bounding_box(float time0, float time1, aabb& output_box) const override {
         output_box = bbox;
         return hasbox;
@@ -188,6 +214,9 @@ public:
     float cos_theta;
     bool hasbox;
     aabb bbox;
+
+private:
+    [[nodiscard]] ray to_object(const ray& r) const;
 };
 
 rotate_z::rotate_z(shared_ptr<hittable> p, float angle) : ptr(std::move(p)) {
@@ -222,7 +251,7 @@ rotate_z::rotate_z(shared_ptr<hittable> p, float angle) : ptr(std::move(p)) {
     bbox = aabb(min, max);
 }
 
-bool rotate_z::hit(const ray& r, float t_min, float t_max, hit_record& rec) const {
+ray rotate_z::to_object(const ray& r) const {
     auto origin = r.origin();
     auto direction = r.direction();
 
@@ -232,7 +261,11 @@ bool rotate_z::hit(const ray& r, float t_min, float t_max, hit_record& rec) cons
     direction[1] = cos_theta*r.direction()[1] - sin_theta*r.direction()[0];
     direction[0] = sin_theta*r.direction()[1] + cos_theta*r.direction()[0];
 
-    ray rotated_r(origin, direction, r.time());
+    return ray(origin, direction, r.time());
+}
+
+bool rotate_z::hit(const ray& r, float t_min, float t_max, hit_record& rec) const {
+    ray rotated_r = to_object(r);
 
     if (!ptr->hit(rotated_r, t_min, t_max, rec))
         return false;
@@ -0,0 +1,154 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#ifndef RAYTRACING_CHECKPOINT_HPP
+#define RAYTRACING_CHECKPOINT_HPP
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "framebuffer.hpp"
+#include "params.hpp"
+#include "scheduler.hpp"
+#include "task.hpp"
+
+inline unsigned samples_in_passes(unsigned passes) {
+    // Samples per pixel of a tile after its first passes, in the current render mode
+    if(passes == 0) return 0;
+    if(params::PROGRESSIVE) return std::min(passes * params::PASS_SAMPLES, params::MAX_SAMPLES);
+    if(params::INTERLEAVED && !params::ADAPTIVE) return std::min(1u << std::min(passes - 1, 31u), params::N_samples);
+    return params::N_samples;
+}
+
+struct checkpoint {
+    // What an interrupted render needs to carry on: the frame so far, the tiles with their costs
+    // and finished passes, and the seed of the units' random streams. Finished units are never
+    // redone and the rest sample the same streams as they would have, so no generator state is
+    // kept. The settings that decide what a unit is are stored as well, so that only the same
+    // render resumes from it; label is the caller's, e.g. the scene's name.
+    //
+    // Not kept: the path guiding field and radiance cache, which a resumed render starts afresh,
+    // and ReSTIR's per-pixel history.
+    using settings_t = std::array<uint32_t, 8>;
+
+    std::string label;
+    uint64_t seed{0};
+    settings_t settings{};
+    unsigned width{0}, height{0};
+    std::vector<tile_rect> tiles;
+    std::vector<float> costs;
+    std::vector<uint32_t> passes;
+    frame_planes planes;
+
+    static settings_t current_settings() {
+        return {params::WIDTH, params::HEIGHT, params::N, params::N_samples, params::MIN_SAMPLES,
+                params::MAX_SAMPLES, params::PASS_SAMPLES,
+                uint32_t(params::ADAPTIVE) | uint32_t(params::PROGRESSIVE) << 1 | uint32_t(params::INTERLEAVED) << 2};
+    }
+
+    [[nodiscard]] bool matches(const std::string& _label) const {
+        return label == _label && settings == current_settings();
+    }
+
+    // The state of a running render. Holds off commits only while the frame is copied.
+    void capture(const framebuffer& fb, const progress& prog) {
+        seed = prog.seed;
+        settings = current_settings();
+        width = fb.width();
+        height = fb.height();
+        tiles.resize(prog.tiles.size());
+        costs.resize(prog.tiles.size());
+        passes.resize(prog.tiles.size());
+        for(unsigned i=0; i < tiles.size(); ++i) {
+            tiles[i] = prog.tiles.tile(i);
+            costs[i] = prog.tiles.cost(i);
+        }
+        fb.snapshot(planes, [&] {
+            for(unsigned i=0; i < passes.size(); ++i) passes[i] = prog.tiles.passes_done(i);
+        });
+    }
+
+    // Sets up a fresh render to carry on from here
+    void restore(framebuffer& fb, progress& prog) const {
+        prog.seed = seed;
+        prog.tiles.assign(width, height, tiles, costs);
+        frame_planes f = planes;
+        float done = 0;
+        for(unsigned i=0; i < tiles.size(); ++i) {
+            prog.tiles.set_passes(i, passes[i]);
+            done += costs[i] * float(samples_in_passes(passes[i]));
+            if(passes[i] > 0) continue;
+            // An adaptive tile commits rounds before it finishes; it starts over
+            const tile_rect& t = tiles[i];
+            for(int c=0; c < frame_planes::channels; ++c)
+                for(unsigned y=t.y; y < t.y + t.h; ++y)
+                    std::fill_n(f.row(c, y) + t.x, t.w, 0.f);
+        }
+        fb.load(f);
+        prog.work_done = done;
+    }
+
+    [[nodiscard]] bool write(const std::string& path) const {
+        // To a temporary first, so that a crash while writing leaves the previous checkpoint
+        const std::string tmp = path + ".tmp";
+        {
+            std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+            auto put = [&out](const auto& v) { out.write(reinterpret_cast<const char*>(&v), sizeof v); };
+            out.write(magic, sizeof magic);
+            put(uint32_t(label.size()));
+            out.write(label.data(), std::streamsize(label.size()));
+            put(seed);
+            put(settings);
+            put(uint32_t(width));
+            put(uint32_t(height));
+            put(uint32_t(tiles.size()));
+            for(unsigned i=0; i < tiles.size(); ++i) {
+                put(tiles[i]);
+                put(costs[i]);
+                put(passes[i]);
+            }
+            for(int c=0; c < frame_planes::channels; ++c)
+                for(unsigned y=0; y < height; ++y)
+                    out.write(reinterpret_cast<const char*>(planes.row(c, y)), std::streamsize(width * sizeof(float)));
+            if(!out.flush()) return false;
+        }
+        return std::rename(tmp.c_str(), path.c_str()) == 0;
+    }
+
+    [[nodiscard]] bool read(const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        auto get = [&in](auto& v) { return bool(in.read(reinterpret_cast<char*>(&v), sizeof v)); };
+        char m[sizeof magic];
+        uint32_t n, w, h;
+        if(!in.read(m, sizeof m) || std::memcmp(m, magic, sizeof m) != 0 || !get(n) || n > 4096) return false;
+        label.resize(n);
+        if(!in.read(label.data(), n) || !get(seed) || !get(settings) || !get(w) || !get(h) || !get(n)) return false;
+        if(w == 0 || h == 0 || w > 1u << 20 || h > 1u << 20 || n > w * h) return false;
+        width = w;
+        height = h;
+        tiles.resize(n);
+        costs.resize(n);
+        passes.resize(n);
+        for(unsigned i=0; i < n; ++i) {
+            if(!get(tiles[i]) || !get(costs[i]) || !get(passes[i])) return false;
+            const tile_rect& t = tiles[i];
+            if(t.x >= w || t.y >= h || t.w > w - t.x || t.h > h - t.y) return false;
+        }
+        planes = frame_planes(w, h);
+        for(int c=0; c < frame_planes::channels; ++c)
+            for(unsigned y=0; y < h; ++y)
+                if(!in.read(reinterpret_cast<char*>(planes.row(c, y)), std::streamsize(w * sizeof(float)))) return false;
+        return true;
+    }
+
+private:
+    static constexpr char magic[8] = {'R', 'T', 'C', 'K', 'P', 'T', '0', '1'};
+};
+
+#endif //RAYTRACING_CHECKPOINT_HPP
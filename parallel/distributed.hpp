@@ -0,0 +1,311 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#ifndef RAYTRACING_DISTRIBUTED_HPP
+#define RAYTRACING_DISTRIBUTED_HPP
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "framebuffer.hpp"
+#include "scheduler.hpp"
+#include "task.hpp"
+#include "thread_pool.hpp"
+
+// Rendering split over processes. A coordinator hands out units, a tile and a range of sample
+// indices each, to worker processes over stream sockets and adds the (sum, count) planes they
+// send back into its frame. Workers build the scene themselves from the same settings, so only
+// units and results cross the wire. Messages are a 32-bit type and then a fixed header, in the
+// byte order of the machines involved.
+
+namespace wire {
+    constexpr int worker_fd = 3; // where spawned workers find their socket
+
+    enum type : uint32_t { unit = 1, result = 2, quit = 3 };
+
+    struct unit_header {
+        uint32_t id;
+        uint32_t x, y, w, h;   // tile
+        uint32_t begin, end;   // sample indices
+    };
+
+    inline bool write_all(int fd, const void* data, size_t n) {
+        auto p = static_cast<const char*>(data);
+        while(n > 0) {
+            const ssize_t k = ::write(fd, p, n);
+            if(k < 0 && errno == EINTR) continue;
+            if(k <= 0) return false;
+            p += k;
+            n -= size_t(k);
+        }
+        return true;
+    }
+
+    inline bool read_all(int fd, void* data, size_t n) {
+        auto p = static_cast<char*>(data);
+        while(n > 0) {
+            const ssize_t k = ::read(fd, p, n);
+            if(k < 0 && errno == EINTR) continue;
+            if(k <= 0) return false;
+            p += k;
+            n -= size_t(k);
+        }
+        return true;
+    }
+
+    inline bool send_unit(int fd, const unit_header& u) {
+        const uint32_t t = unit;
+        return write_all(fd, &t, sizeof t) && write_all(fd, &u, sizeof u);
+    }
+
+    inline bool send_quit(int fd) {
+        const uint32_t t = quit;
+        return write_all(fd, &t, sizeof t);
+    }
+
+    inline bool send_result(int fd, const unit_header& u, const frame_planes& planes) {
+        // The tile's planes one after another, rows without padding
+        std::vector<float> payload;
+        payload.reserve(size_t(frame_planes::channels) * u.w * u.h);
+        for(int c=0; c < frame_planes::channels; ++c)
+            for(unsigned y=u.y; y < u.y + u.h; ++y)
+                payload.insert(payload.end(), planes.row(c, y), planes.row(c, y) + u.w);
+        const uint32_t t = result;
+        return write_all(fd, &t, sizeof t) && write_all(fd, &u, sizeof u)
+               && write_all(fd, payload.data(), payload.size() * sizeof(float));
+    }
+
+    // Bytes of the planes that follow a result for unit u
+    inline size_t planes_size(const unit_header& u) {
+        return size_t(frame_planes::channels) * u.w * u.h * sizeof(float);
+    }
+
+    // Copies the planes of a result for unit u, planes_size(u) bytes at data, into acc
+    inline void copy_planes(const char* data, const unit_header& u, tile_accumulator& acc) {
+        acc.reset({u.x, u.y, u.w, u.h});
+        frame_planes& planes = acc.local();
+        for(int c=0; c < frame_planes::channels; ++c)
+            for(unsigned y=u.y; y < u.y + u.h; ++y, data += u.w * sizeof(float))
+                std::memcpy(planes.row(c, y), data, u.w * sizeof(float));
+    }
+}
+
+inline void run_worker(int fd, scene& scn, camera& cam, unsigned threads) {
+    // Serves units from fd on its own threads until told to quit or the coordinator goes away
+    progress prog;
+    std::mutex out;
+    thread_pool pool{threads};
+    while(true) {
+        uint32_t type;
+        wire::unit_header u{};
+        if(!wire::read_all(fd, &type, sizeof type) || type != wire::unit || !wire::read_all(fd, &u, sizeof u))
+            break;
+        pool.submit([&, u](unsigned worker) {
+            Task task{&scn, &cam, nullptr, &prog, int(worker)};
+            task.set_rect({u.x, u.y, u.w, u.h});
+            for(unsigned s=u.begin; s < u.end; ++s)
+                task.sample_tile();
+            std::lock_guard<std::mutex> lock{out};
+            wire::send_result(fd, u, task.acc.local());
+        });
+    }
+}
+
+inline bool spawn_worker(const std::vector<std::string>& args, int& fd, pid_t& pid) {
+    // Starts args[0] with the given arguments and a socket to this process as its fd 3
+    int sv[2];
+    if(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) return false;
+    fcntl(sv[0], F_SETFD, FD_CLOEXEC);
+    pid = fork();
+    if(pid < 0) {
+        close(sv[0]);
+        close(sv[1]);
+        return false;
+    }
+    if(pid == 0) {
+        if(sv[1] != wire::worker_fd) {
+            dup2(sv[1], wire::worker_fd);
+            close(sv[1]);
+        }
+        std::vector<char*> argv;
+        for(auto& a : args) argv.push_back(const_cast<char*>(a.c_str()));
+        argv.push_back(nullptr);
+        execvp(argv[0], argv.data());
+        _exit(127);
+    }
+    close(sv[1]);
+    fd = sv[0];
+    return true;
+}
+
+class coordinator {
+    // Splits the frame into tiles of tile_size and every tile's spp samples into ranges of at
+    // most chunk, handed out range by range so that the whole frame refines evenly. Each worker
+    // has up to depth units in flight. A worker that closes its socket, sends garbage or sends
+    // nothing for timeout seconds while it holds units is dropped and its units go back to the
+    // front of the queue. Results are read as far as they have arrived, so a stalled worker
+    // never holds up the others.
+public:
+    coordinator(framebuffer& _fb, unsigned tile_size, tile_order order, unsigned spp, unsigned chunk, unsigned _depth,
+                float _timeout = 60)
+            : fb{_fb}, depth{std::max(_depth, 1u)}, timeout{std::chrono::duration<float>(std::max(_timeout, .1f))} {
+        tile_scheduler tiles;
+        tiles.reset(fb.width(), fb.height(), tile_size, order);
+        chunk = std::max(chunk, 1u);
+        for(unsigned begin=0; begin < spp; begin += chunk)
+            for(unsigned i=0; i < tiles.size(); ++i) {
+                const tile_rect& t = tiles.tile(i);
+                units.push_back({uint32_t(units.size()), t.x, t.y, t.w, t.h, begin, std::min(begin + chunk, spp)});
+            }
+        for(auto& u : units) pending.push_back(u.id);
+        signal(SIGPIPE, SIG_IGN);
+    }
+
+    coordinator(const coordinator&) = delete;
+    coordinator& operator=(const coordinator&) = delete;
+
+    ~coordinator() {
+        for(auto& w : workers) {
+            if(w.alive) {
+                wire::send_quit(w.fd);
+                close(w.fd);
+            }
+            if(w.pid > 0) waitpid(w.pid, nullptr, 0);
+        }
+    }
+
+    // fd is a connected stream to a worker; pid, if it is a child, is reaped at the end
+    void add_worker(int fd, pid_t pid = -1) {
+        workers.push_back({fd, pid, {}, {}, {}, true});
+    }
+
+    [[nodiscard]] float fraction_done() const { return units.empty() ? 1 : float(done) / float(units.size()); }
+    [[nodiscard]] unsigned workers_lost() const { return lost; }
+    [[nodiscard]] unsigned units_reissued() const { return reissued; }
+
+    // Runs until every unit is merged, calling report about once a second. False if every
+    // worker was lost first.
+    bool run(const std::function<void()>& report = {}) {
+        auto last_report = std::chrono::steady_clock::now();
+        while(done < units.size()) {
+            std::vector<pollfd> fds;
+            std::vector<remote*> polled;
+            for(auto& w : workers) {
+                while(w.alive && w.in_flight.size() < depth && !pending.empty()) {
+                    const uint32_t id = pending.front();
+                    pending.pop_front();
+                    // An idle worker's deadline starts with its first unit
+                    if(w.in_flight.empty()) w.last_heard = std::chrono::steady_clock::now();
+                    w.in_flight.push_back(id);
+                    if(!wire::send_unit(w.fd, units[id])) drop(w);
+                }
+                if(w.alive && !w.in_flight.empty() && std::chrono::steady_clock::now() - w.last_heard > timeout)
+                    drop(w);
+                if(w.alive) {
+                    fds.push_back({w.fd, POLLIN, 0});
+                    polled.push_back(&w);
+                }
+            }
+            if(fds.empty()) return false;
+
+            if(poll(fds.data(), fds.size(), 1000) < 0 && errno != EINTR) return false;
+            for(size_t i=0; i < fds.size(); ++i)
+                if(fds[i].revents) receive(*polled[i]);
+
+            if(report && std::chrono::steady_clock::now() - last_report >= std::chrono::seconds(1)) {
+                report();
+                last_report = std::chrono::steady_clock::now();
+            }
+        }
+        return true;
+    }
+
+private:
+    struct remote {
+        int fd;
+        pid_t pid;
+        std::vector<uint32_t> in_flight;
+        std::vector<char> inbox; // received and not yet merged
+        std::chrono::steady_clock::time_point last_heard;
+        bool alive;
+    };
+
+    framebuffer& fb;
+    unsigned depth;
+    std::chrono::duration<float> timeout;
+    std::vector<wire::unit_header> units;
+    std::deque<uint32_t> pending;
+    std::vector<remote> workers;
+    tile_accumulator acc;
+    size_t done{0};
+    unsigned lost{0}, reissued{0};
+
+    void receive(remote& w) {
+        // Takes whatever has arrived without waiting for more, then merges every whole result
+        bool closed = false;
+        char buf[1 << 16];
+        while(true) {
+            const ssize_t k = ::recv(w.fd, buf, sizeof buf, MSG_DONTWAIT);
+            if(k > 0) {
+                w.inbox.insert(w.inbox.end(), buf, buf + k);
+                w.last_heard = std::chrono::steady_clock::now();
+                continue;
+            }
+            if(k < 0 && errno == EINTR) continue;
+            closed = k == 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+            break;
+        }
+
+        constexpr size_t head = sizeof(uint32_t) + sizeof(wire::unit_header);
+        size_t at = 0;
+        while(w.inbox.size() - at >= head) {
+            uint32_t type;
+            wire::unit_header u{};
+            std::memcpy(&type, w.inbox.data() + at, sizeof type);
+            std::memcpy(&u, w.inbox.data() + at + sizeof type, sizeof u);
+            // Only results for units this worker holds, as they were sent
+            const auto it = std::find(w.in_flight.begin(), w.in_flight.end(), u.id);
+            if(type != wire::result || it == w.in_flight.end() || std::memcmp(&u, &units[u.id], sizeof u) != 0) {
+                drop(w);
+                return;
+            }
+            if(w.inbox.size() - at - head < wire::planes_size(u)) break;
+            wire::copy_planes(w.inbox.data() + at + head, u, acc);
+            at += head + wire::planes_size(u);
+            w.in_flight.erase(it);
+            fb.commit(acc);
+            ++done;
+        }
+        w.inbox.erase(w.inbox.begin(), w.inbox.begin() + ptrdiff_t(at));
+        if(closed) drop(w);
+    }
+
+    void drop(remote& w) {
+        w.alive = false;
+        w.inbox.clear();
+        close(w.fd);
+        if(w.pid > 0) kill(w.pid, SIGKILL);
+        ++lost;
+        reissued += unsigned(w.in_flight.size());
+        pending.insert(pending.begin(), w.in_flight.begin(), w.in_flight.end());
+        w.in_flight.clear();
+    }
+};
+
+#endif //RAYTRACING_DISTRIBUTED_HPP
@@ -0,0 +1,169 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#ifndef RAYTRACING_FRAMEBUFFER_HPP
+#define RAYTRACING_FRAMEBUFFER_HPP
+
+#include <algorithm>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+
+#include "rtweekend.hpp"
+#include "color.hpp"
+#include "scheduler.hpp"
+
+class frame_planes {
+    // Per-pixel accumulation in separate planes: the sums of red, green and blue, the number of
+    // samples and the sum of squared sample luminance. Rows are padded to whole cache lines and
+    // every plane starts on one. (x, y) are frame coordinates starting at origin_x, origin_y.
+public:
+    enum channel { red, green, blue, weight, sq_lum, channels };
+
+    frame_planes() = default;
+    frame_planes(unsigned _w, unsigned _h, unsigned _x0 = 0, unsigned _y0 = 0)
+            : origin_x{_x0}, origin_y{_y0}, w{_w}, h{_h}, stride{(_w + floats_per_line - 1) / floats_per_line * floats_per_line},
+              lines(size_t(stride / floats_per_line) * h * channels) {}
+
+    [[nodiscard]] unsigned width() const { return w; }
+    [[nodiscard]] unsigned height() const { return h; }
+
+    [[nodiscard]] float* row(int c, unsigned y) {
+        return reinterpret_cast<float*>(lines.data()) + (size_t(c) * h + (y - origin_y)) * stride;
+    }
+    [[nodiscard]] const float* row(int c, unsigned y) const {
+        return reinterpret_cast<const float*>(lines.data()) + (size_t(c) * h + (y - origin_y)) * stride;
+    }
+
+    [[nodiscard]] float& at(int c, unsigned x, unsigned y) { return row(c, y)[x - origin_x]; }
+    [[nodiscard]] float at(int c, unsigned x, unsigned y) const { return row(c, y)[x - origin_x]; }
+
+    [[nodiscard]] float samples(unsigned x, unsigned y) const { return at(weight, x, y); }
+    [[nodiscard]] color sum(unsigned x, unsigned y) const {
+        return color(at(red, x, y), at(green, x, y), at(blue, x, y));
+    }
+    [[nodiscard]] color mean(unsigned x, unsigned y) const {
+        const float n = samples(x, y);
+        return n > 0 ? sum(x, y) / n : color(0, 0, 0);
+    }
+
+    void add(unsigned x, unsigned y, const color& col) {
+        at(red, x, y) += col.x();
+        at(green, x, y) += col.y();
+        at(blue, x, y) += col.z();
+        at(weight, x, y) += 1;
+        const float lum = luminance(col);
+        at(sq_lum, x, y) += lum * lum;
+    }
+
+    void clear() { std::fill(lines.begin(), lines.end(), cache_line{}); }
+
+private:
+    static constexpr unsigned floats_per_line = 16;
+    struct alignas(64) cache_line { float v[floats_per_line]{}; };
+
+    unsigned origin_x{0}, origin_y{0};
+    unsigned w{0}, h{0}, stride{0};
+    std::vector<cache_line> lines;
+};
+
+class tile_accumulator {
+    // Samples of one tile, kept local to the worker rendering it until commit()
+public:
+    void reset(const tile_rect& t) {
+        if(t.w != planes.width() || t.h != planes.height() || t.x != rect.x || t.y != rect.y)
+            planes = frame_planes(t.w, t.h, t.x, t.y);
+        else
+            planes.clear();
+        rect = t;
+    }
+
+    [[nodiscard]] const tile_rect& tile() const { return rect; }
+    [[nodiscard]] const frame_planes& local() const { return planes; }
+    // For filling the tile with samples from elsewhere, such as another process
+    [[nodiscard]] frame_planes& local() { return planes; }
+
+    void add(unsigned x, unsigned y, const color& col) { planes.add(x, y, col); }
+
+private:
+    tile_rect rect{0, 0, 0, 0};
+    frame_planes planes;
+    friend class framebuffer;
+};
+
+class framebuffer {
+    // The frame being rendered. Workers commit whole tiles, which may happen concurrently since
+    // tiles never overlap; snapshot() holds commits off while it copies, so it never sees half a
+    // tile. That is the shared mutex used the other way round: committers share it, readers of
+    // the whole frame take it exclusively.
+public:
+    framebuffer(unsigned w, unsigned h) : planes(w, h) {}
+
+    [[nodiscard]] unsigned width() const { return planes.width(); }
+    [[nodiscard]] unsigned height() const { return planes.height(); }
+
+    // Adds the tile's samples to the frame and clears the tile
+    void commit(tile_accumulator& t) {
+        commit(t, [] {});
+    }
+
+    // Also runs also() before any snapshot can see the tile, for bookkeeping that must match
+    // the frame, like counting the tile's finished passes
+    template<typename F>
+    void commit(tile_accumulator& t, F&& also) {
+        std::shared_lock<std::shared_mutex> lock{m};
+        const tile_rect& r = t.rect;
+        for(int c=0; c < frame_planes::channels; ++c) {
+            for(unsigned y=r.y; y < r.y + r.h; ++y) {
+                float* dst = planes.row(c, y) + r.x;
+                const float* src = t.planes.row(c, y);
+                for(unsigned x=0; x < r.w; ++x) dst[x] += src[x];
+            }
+        }
+        t.planes.clear();
+        also();
+    }
+
+    void snapshot(frame_planes& out) const {
+        snapshot(out, [] {});
+    }
+
+    // Also runs also() while no commit is under way, to read bookkeeping done by commit's
+    template<typename F>
+    void snapshot(frame_planes& out, F&& also) const {
+        std::unique_lock<std::shared_mutex> lock{m};
+        out = planes;
+        also();
+    }
+
+    // Copies the part of the frame in r into the same place in out, a frame of the same size,
+    // between commits; for keeping a copy up to date one tile at a time
+    void snapshot(frame_planes& out, const tile_rect& r) const {
+        std::unique_lock<std::shared_mutex> lock{m};
+        for(int c=0; c < frame_planes::channels; ++c)
+            for(unsigned y=r.y; y < r.y + r.h; ++y)
+                std::copy_n(planes.row(c, y) + r.x, r.w, out.row(c, y) + r.x);
+    }
+
+    // Replaces the whole frame, e.g. with one saved earlier
+    void load(const frame_planes& from) {
+        std::unique_lock<std::shared_mutex> lock{m};
+        planes = from;
+    }
+
+    [[nodiscard]] frame_planes snapshot() const {
+        frame_planes out;
+        snapshot(out);
+        return out;
+    }
+
+    // Unlocked view for pixels of a tile the caller is rendering, which no one else writes
+    [[nodiscard]] const frame_planes& owned() const { return planes; }
+
+private:
+    frame_planes planes;
+    mutable std::shared_mutex m;
+};
+
+#endif //RAYTRACING_FRAMEBUFFER_HPP
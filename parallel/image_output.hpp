@@ -0,0 +1,320 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#ifndef RAYTRACING_IMAGE_OUTPUT_HPP
+#define RAYTRACING_IMAGE_OUTPUT_HPP
+
+#include <array>
+#include <bit>
+#include <cctype>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "framebuffer.hpp"
+#include "pixels.hpp"
+
+// Image files written straight from the accumulation planes: linear float as PFM or as OpenEXR
+// with the sample counts as a fourth channel, and 8-bit binary PPM or PNG with the viewer's
+// gamma. Frame row 0 is the bottom of the image; rows are converted and written one at a time.
+
+enum class image_format { ppm, pfm, exr, png, unknown };
+
+inline image_format format_of(const std::string& path) {
+    // From the file's extension
+    const auto dot = path.find_last_of('.');
+    if(dot == std::string::npos) return image_format::unknown;
+    std::string ext = path.substr(dot + 1);
+    for(char& c : ext) c = char(std::tolower(static_cast<unsigned char>(c)));
+    if(ext == "ppm") return image_format::ppm;
+    if(ext == "pfm") return image_format::pfm;
+    if(ext == "exr") return image_format::exr;
+    if(ext == "png") return image_format::png;
+    return image_format::unknown;
+}
+
+namespace image_detail {
+    inline void mean_row(const frame_planes& f, unsigned y, float* rgb) {
+        // Linear mean of row y, RGB interleaved; black where nothing was sampled
+        const float* r = f.row(frame_planes::red, y);
+        const float* g = f.row(frame_planes::green, y);
+        const float* b = f.row(frame_planes::blue, y);
+        const float* n = f.row(frame_planes::weight, y);
+        for(unsigned x=0; x < f.width(); ++x) {
+            const float inv = n[x] > 0 ? 1 / n[x] : 0;
+            rgb[3 * x + 0] = r[x] * inv;
+            rgb[3 * x + 1] = g[x] * inv;
+            rgb[3 * x + 2] = b[x] * inv;
+        }
+    }
+
+    template<typename T>
+    void put_le(std::string& out, T v) {
+        // Little endian whatever the host, as EXR wants
+        const auto u = std::bit_cast<std::array<unsigned char, sizeof v>>(v);
+        if constexpr(std::endian::native == std::endian::little) out.append(u.begin(), u.end());
+        else out.append(u.rbegin(), u.rend());
+    }
+
+    inline void put_be32(std::string& out, uint32_t v) {
+        for(int s=24; s >= 0; s -= 8) out.push_back(char(v >> s));
+    }
+
+    inline uint32_t crc32(const char* data, size_t n, uint32_t crc = 0) {
+        static const auto table = [] {
+            std::array<uint32_t, 256> t{};
+            for(uint32_t i=0; i < 256; ++i) {
+                uint32_t c = i;
+                for(int k=0; k < 8; ++k) c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                t[i] = c;
+            }
+            return t;
+        }();
+        crc = ~crc;
+        for(size_t i=0; i < n; ++i) crc = table[(crc ^ uint8_t(data[i])) & 0xff] ^ (crc >> 8);
+        return ~crc;
+    }
+
+    inline void write_png_chunk(std::ofstream& out, const char* type, const std::string& data) {
+        std::string chunk;
+        put_be32(chunk, uint32_t(data.size()));
+        chunk.append(type, 4);
+        chunk += data;
+        put_be32(chunk, crc32(chunk.data() + 4, chunk.size() - 4));
+        out.write(chunk.data(), std::streamsize(chunk.size()));
+    }
+}
+
+inline bool write_ppm(const std::string& path, const std::vector<uint8_t>& rgba, unsigned w, unsigned h) {
+    // Binary PPM of top-down RGBA as pixels makes it
+    std::ofstream out(path, std::ios::binary);
+    out << "P6\n" << w << ' ' << h << "\n255\n";
+    std::vector<char> line(size_t(w) * 3);
+    for(unsigned y=0; y < h && out; ++y) {
+        const uint8_t* p = &rgba[size_t(y) * w * 4];
+        for(unsigned x=0; x < w; ++x)
+            for(int c=0; c < 3; ++c) line[3 * x + c] = char(p[4 * x + c]);
+        out.write(line.data(), std::streamsize(line.size()));
+    }
+    return bool(out.flush());
+}
+
+inline bool write_png(const std::string& path, const std::vector<uint8_t>& rgba, unsigned w, unsigned h) {
+    // RGB PNG of top-down RGBA, in stored deflate blocks: no compression, but no zlib either
+    std::ofstream out(path, std::ios::binary);
+    out.write("\x89PNG\r\n\x1a\n", 8);
+
+    std::string header;
+    image_detail::put_be32(header, w);
+    image_detail::put_be32(header, h);
+    header += std::string{8, 2, 0, 0, 0}; // 8 bits, RGB, deflate, no filter, no interlace
+    image_detail::write_png_chunk(out, "IHDR", header);
+
+    // Every row is a filter byte and its RGB; the zlib stream splits them into blocks of 64 KiB
+    std::string raw;
+    raw.reserve(size_t(h) * (1 + size_t(w) * 3));
+    for(unsigned y=0; y < h; ++y) {
+        raw.push_back(0);
+        const uint8_t* p = &rgba[size_t(y) * w * 4];
+        for(unsigned x=0; x < w; ++x) raw.append(reinterpret_cast<const char*>(p + 4 * x), 3);
+    }
+    std::string z{'\x78', '\x01'};
+    z.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+    size_t pos = 0;
+    do {
+        const auto n = uint16_t(std::min<size_t>(raw.size() - pos, 65535));
+        z.push_back(pos + n == raw.size() ? 1 : 0);
+        image_detail::put_le(z, n);
+        image_detail::put_le(z, uint16_t(~n));
+        z.append(raw, pos, n);
+        pos += n;
+    } while(pos < raw.size());
+    uint32_t a = 1, b = 0;
+    for(char c : raw) {
+        a = (a + uint8_t(c)) % 65521;
+        b = (b + a) % 65521;
+    }
+    image_detail::put_be32(z, b << 16 | a);
+    image_detail::write_png_chunk(out, "IDAT", z);
+    image_detail::write_png_chunk(out, "IEND", {});
+    return bool(out.flush());
+}
+
+inline bool write_pfm(const std::string& path, const frame_planes& f) {
+    // Linear RGB, bottom row first as PFM has it; a negative scale marks little endian
+    std::ofstream out(path, std::ios::binary);
+    out << "PF\n" << f.width() << ' ' << f.height() << '\n'
+        << (std::endian::native == std::endian::little ? "-1.0" : "1.0") << '\n';
+    std::vector<float> rgb(size_t(f.width()) * 3);
+    for(unsigned y=0; y < f.height() && out; ++y) {
+        image_detail::mean_row(f, y, rgb.data());
+        out.write(reinterpret_cast<const char*>(rgb.data()), std::streamsize(rgb.size() * sizeof(float)));
+    }
+    return bool(out.flush());
+}
+
+namespace exr_layout {
+    // Uncompressed scanline OpenEXR with 32-bit float channels B, G, R and samples, the number
+    // of samples behind each pixel. One scanline per chunk, top row first; since every chunk
+    // has the same size, where any pixel goes is known before anything is written.
+    constexpr const char* names[] = {"B", "G", "R", "samples"}; // sorted, as EXR wants
+    constexpr int planes[] = {frame_planes::blue, frame_planes::green, frame_planes::red, frame_planes::weight};
+    constexpr unsigned channels = std::size(names);
+
+    inline uint64_t chunk_bytes(unsigned w) { return 8 + uint64_t(w) * channels * sizeof(float); }
+
+    // Magic number, attributes and the offset table; scanline y follows at size() + y * chunk_bytes(w)
+    inline std::string header(unsigned w, unsigned h) {
+        using image_detail::put_le;
+        std::string head{'\x76', '\x2f', '\x31', '\x01', 2, 0, 0, 0};
+        auto attribute = [&head](const char* name, const char* type, const std::string& value) {
+            head.append(name).push_back(0);
+            head.append(type).push_back(0);
+            put_le(head, int32_t(value.size()));
+            head += value;
+        };
+        std::string v;
+        for(const char* n : names) {
+            v.append(n).push_back(0);
+            put_le(v, int32_t(2)); // FLOAT
+            put_le(v, int32_t(0)); // linear flag and reserved
+            put_le(v, int32_t(1)); // no subsampling
+            put_le(v, int32_t(1));
+        }
+        v.push_back(0);
+        attribute("channels", "chlist", v);
+        attribute("compression", "compression", std::string(1, 0));
+        v.clear();
+        for(int32_t c : {0, 0, int32_t(w) - 1, int32_t(h) - 1}) put_le(v, c);
+        attribute("dataWindow", "box2i", v);
+        attribute("displayWindow", "box2i", v);
+        attribute("lineOrder", "lineOrder", std::string(1, 0)); // increasing y
+        v.clear();
+        put_le(v, 1.f);
+        attribute("pixelAspectRatio", "float", v);
+        attribute("screenWindowWidth", "float", v);
+        v.clear();
+        put_le(v, 0.f);
+        put_le(v, 0.f);
+        attribute("screenWindowCenter", "v2f", v);
+        head.push_back(0);
+
+        const uint64_t first = head.size() + uint64_t(h) * 8;
+        for(uint64_t y=0; y < h; ++y) put_le(head, first + y * chunk_bytes(w));
+        return head;
+    }
+}
+
+inline bool write_exr(const std::string& path, const frame_planes& f) {
+    // All at once, in the layout of exr_layout
+    using image_detail::put_le;
+    const unsigned w = f.width(), h = f.height();
+    const uint64_t chunk_bytes = exr_layout::chunk_bytes(w);
+    const std::string head = exr_layout::header(w, h);
+
+    std::ofstream out(path, std::ios::binary);
+    out.write(head.data(), std::streamsize(head.size()));
+    std::string chunk;
+    chunk.reserve(chunk_bytes);
+    for(unsigned y=0; y < h && out; ++y) {
+        const unsigned row = h - 1 - y;
+        chunk.clear();
+        put_le(chunk, int32_t(y));
+        put_le(chunk, int32_t(chunk_bytes - 8));
+        for(int p : exr_layout::planes) {
+            const float* n = f.row(frame_planes::weight, row);
+            const float* s = f.row(p, row);
+            for(unsigned x=0; x < w; ++x)
+                put_le(chunk, p == frame_planes::weight ? n[x] : n[x] > 0 ? s[x] / n[x] : 0.f);
+        }
+        out.write(chunk.data(), std::streamsize(chunk.size()));
+    }
+    return bool(out.flush());
+}
+
+inline bool write_image(const std::string& path, const frame_planes& f) {
+    // In the format its extension names; false for an unknown one or if writing failed
+    const image_format format = format_of(path);
+    if(format == image_format::pfm) return write_pfm(path, f);
+    if(format == image_format::exr) return write_exr(path, f);
+    if(format == image_format::unknown) return false;
+    pixels pix(f.width(), f.height());
+    const std::vector<uint8_t>& rgba = pix.get_pixels(f);
+    return format == image_format::png ? write_png(path, rgba, f.width(), f.height())
+                                       : write_ppm(path, rgba, f.width(), f.height());
+}
+
+class image_writer {
+    // Encodes and writes images on a thread of its own, in the order they were handed over, so
+    // that the threads rendering never wait for the disk. Images are moved in; whatever is
+    // queued is written before the writer is destroyed.
+public:
+    image_writer() : thread([this] { run(); }) {}
+
+    image_writer(const image_writer&) = delete;
+    image_writer& operator=(const image_writer&) = delete;
+
+    ~image_writer() {
+        {
+            std::lock_guard<std::mutex> lock{m};
+            stopping = true;
+        }
+        queued.notify_one();
+        thread.join();
+    }
+
+    // True once path is written, false if that failed
+    std::future<bool> write(std::string path, frame_planes image) {
+        return push([path = std::move(path), image = std::move(image)] { return write_image(path, image); });
+    }
+
+    // An 8-bit map such as those pixels makes, as PNG or PPM
+    std::future<bool> write(std::string path, std::vector<uint8_t> rgba, unsigned w, unsigned h) {
+        return push([path = std::move(path), rgba = std::move(rgba), w, h] {
+            const image_format format = format_of(path);
+            if(format == image_format::png) return write_png(path, rgba, w, h);
+            return format == image_format::ppm && write_ppm(path, rgba, w, h);
+        });
+    }
+
+private:
+    std::mutex m;
+    std::condition_variable queued;
+    std::deque<std::packaged_task<bool()>> jobs;
+    bool stopping{false};
+    std::thread thread;
+
+    std::future<bool> push(std::function<bool()> job) {
+        std::packaged_task<bool()> task{std::move(job)};
+        auto result = task.get_future();
+        {
+            std::lock_guard<std::mutex> lock{m};
+            jobs.push_back(std::move(task));
+        }
+        queued.notify_one();
+        return result;
+    }
+
+    void run() {
+        while(true) {
+            std::unique_lock<std::mutex> lock{m};
+            queued.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if(jobs.empty()) return;
+            auto job = std::move(jobs.front());
+            jobs.pop_front();
+            lock.unlock();
+            job();
+        }
+    }
+};
+
+#endif //RAYTRACING_IMAGE_OUTPUT_HPP
@@ -0,0 +1,42 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#include "params.hpp"
+
+float params::ASPECT_RATIO = 16.f/9.f;
+unsigned params::WIDTH = 200;
+unsigned params::HEIGHT = int(params::WIDTH / params::ASPECT_RATIO);
+
+unsigned params::N = 16;//16;
+unsigned params::N_samples = 10;
+unsigned params::MAX_DEPTH = 50;
+unsigned params::RR_DEPTH = 3;
+
+bool params::ADAPTIVE = false;
+unsigned params::MIN_SAMPLES = 4;
+unsigned params::MAX_SAMPLES = 64;
+float params::MAX_ERROR = .02f;
+
+bool params::PROGRESSIVE = false;
+unsigned params::PASS_SAMPLES = 1;
+unsigned params::TIME_BUDGET = 0;
+float params::TARGET_ERROR = 0;
+bool params::INTERLEAVED = true;
+
+bool params::GUIDING = false;
+unsigned params::GUIDING_PASSES = 8;
+
+bool params::CACHE = false;
+unsigned params::CACHE_DEPTH = 2;
+float params::CACHE_CELL = 10;
+unsigned params::CACHE_SAMPLES = 16;
+
+bool params::RESTIR = false;
+unsigned params::RESTIR_CANDIDATES = 32;
+unsigned params::RESTIR_NEIGHBOURS = 4;
+bool params::RESTIR_TEMPORAL = true;
+
+tile_order params::TILE_ORDER = tile_order::snake;
+bool params::COST_SPLIT = false;
+bool params::NUMA = false;
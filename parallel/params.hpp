@@ -5,6 +5,8 @@
 #ifndef RAYTRACING_PARAMS_HPP
 #define RAYTRACING_PARAMS_HPP
 
+#include "scheduler.hpp"
+
 struct params {
     static float ASPECT_RATIO;
     static unsigned WIDTH;
@@ -12,10 +14,52 @@ struct params {
 
     static unsigned N;
     static unsigned N_samples;
-    static unsigned MAX_DEPTH;
+    static unsigned MAX_DEPTH;  // hard bounce cap
+    static unsigned RR_DEPTH;   // bounces before Russian roulette kicks in
+
+    // Adaptive sampling: N_samples becomes the average per-pixel budget of a tile
+    static bool ADAPTIVE;
+    static unsigned MIN_SAMPLES; // samples per pixel in each round
+    static unsigned MAX_SAMPLES; // per-pixel cap
+    static float MAX_ERROR;      // relative error at which a pixel stops sampling
+
+    // Progressive rendering: whole-frame passes until the time budget or target error is met
+    static bool PROGRESSIVE;
+    static unsigned PASS_SAMPLES; // samples per pixel added by each pass
+    static unsigned TIME_BUDGET;  // milliseconds, 0 for no limit
+    static float TARGET_ERROR;    // mean relative error, 0 for no target
+
+    // Fixed-sample renders without ADAPTIVE: the whole frame refines at 1, 2, 4... spp instead
+    // of finishing one tile at a time
+    static bool INTERLEAVED;
+
+    // Path guiding: learned from the first GUIDING_PASSES progressive passes, needs PROGRESSIVE
+    static bool GUIDING;
+    static unsigned GUIDING_PASSES;
+
+    // Radiance cache: paths CACHE_DEPTH or more bounces deep end at cache cells holding at least
+    // CACHE_SAMPLES estimates. Larger cells and fewer samples trade variance and time for bias.
+    static bool CACHE;
+    static unsigned CACHE_DEPTH;
+    static float CACHE_CELL;      // world units
+    static unsigned CACHE_SAMPLES;
+
+    // Reservoir resampling of direct light at primary hits, for scenes without media. Not used
+    // by ADAPTIVE, which samples pixels one at a time. Primary hits then train neither GUIDING
+    // nor CACHE, whose estimates there would lack the resampled light.
+    static bool RESTIR;
+    static unsigned RESTIR_CANDIDATES; // light samples streamed into each new reservoir
+    static unsigned RESTIR_NEIGHBOURS; // spatial reuse within the tile, 0 to disable
+    static bool RESTIR_TEMPORAL;       // reuse each pixel's reservoir from its previous sample
 
-    static unsigned W_CNT;
-    static unsigned H_CNT;
+    static tile_order TILE_ORDER; // order in which tiles are handed to threads
+    // Times one sample per block of a quarter tile before rendering, then splits expensive tiles
+    // and hands all of them out longest first instead of in TILE_ORDER. Off by default: the probe
+    // costs a sample per block up front and only pays off when cost varies a lot across the frame.
+    static bool COST_SPLIT;
+    // Pins render threads to cores across NUMA nodes and interleaves the scene and frame over the
+    // nodes' memory
+    static bool NUMA;
 };
 
 
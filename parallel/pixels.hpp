@@ -5,11 +5,17 @@
 #ifndef RAYTRACING_PIXELS_HPP
 #define RAYTRACING_PIXELS_HPP
 
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <memory>
 #include <vector>
-#include <SFML/Graphics.hpp>
 
 #include "rtweekend.hpp"
+#include "framebuffer.hpp"
+#include "scheduler.hpp"
 
 class pixels {
 public:
@@ -19,31 +25,107 @@ public:
               pix(width * height * 4) // RGBA
     {}
 
-    std::vector<sf::Uint8> get_pixels(std::vector<float>& data) {
+    const std::vector<uint8_t>& get_pixels(const frame_planes& f) {
         // Convert accumulated pixels so we can display them
-        for(int i=0; i < height; ++i) {
-            for(int j=0; j < width; ++j) {
-                const unsigned data_pos = (i * width + j) * 5;
+        for(unsigned i=0; i < height; ++i)
+            tonemap_row(f, i, 0, width, &pix[size_t(height - i - 1) * width * 4]);
+        return pix;
+    }
+
+    // The part of the frame in t, top row first, as RGBA in out, e.g. for a texture update at
+    // (t.x, height - t.y - t.h)
+    void get_tile_pixels(const frame_planes& f, const tile_rect& t, std::vector<uint8_t>& out) const {
+        out.resize(size_t(t.w) * t.h * 4);
+        for(unsigned i=0; i < t.h; ++i)
+            tonemap_row(f, t.y + i, t.x, t.w, &out[size_t(t.h - i - 1) * t.w * 4]);
+    }
+
+    std::vector<uint8_t> get_sample_map(const frame_planes& f) const {
+        // Grey-scale map of samples spent per pixel, scaled to the busiest pixel
+        float max_ns = 1;
+        for(unsigned i=0; i < height; ++i)
+            for(unsigned j=0; j < width; ++j) max_ns = fmax(max_ns, f.samples(j, i));
+
+        std::vector<uint8_t> map(width * height * 4);
+        for(unsigned i=0; i < height; ++i) {
+            for(unsigned j=0; j < width; ++j) {
                 const unsigned pix_pos = ((height - i - 1) * width + j) << 2;
-                const float ns = data[data_pos + 4]; // number of accumulated values
-//                // Replace nan components with zero
-//                if(data[data_pos + 0] != data[data_pos + 0]) data[data_pos + 0] = .0f;
-//                if(data[data_pos + 1] != data[data_pos + 1]) data[data_pos + 1] = .0f;
-//                if(data[data_pos + 2] != data[data_pos + 2]) data[data_pos + 2] = .0f;
-
-                pix[pix_pos + 0] = sf::Uint8(colCap(255.99 * sqrt(data[data_pos + 0] / ns)));
-                pix[pix_pos + 1] = sf::Uint8(colCap(255.99 * sqrt(data[data_pos + 1] / ns)));
-                pix[pix_pos + 2] = sf::Uint8(colCap(255.99 * sqrt(data[data_pos + 2] / ns)));
-                pix[pix_pos + 3] = 255u;
+                const auto level = uint8_t(colCap(255.99 * f.samples(j, i) / max_ns));
+                map[pix_pos + 0] = map[pix_pos + 1] = map[pix_pos + 2] = level;
+                map[pix_pos + 3] = 255u;
             }
         }
-        return pix;
+        return map;
+    }
+
+    std::vector<uint8_t> get_tile_cost_map(const tile_scheduler& tiles) const {
+        // Grey-scale map of render time per pixel of each tile, scaled to the slowest tile
+        std::vector<float> cost(width * height);
+        float max_cost = 0;
+        for(unsigned i=0; i < tiles.size(); ++i) {
+            const tile_rect& t = tiles.tile(i);
+            const float c = tiles.time(i) / float(t.area());
+            max_cost = fmax(max_cost, c);
+            for(unsigned y=t.y; y < t.y + t.h && y < height; ++y)
+                for(unsigned x=t.x; x < t.x + t.w && x < width; ++x)
+                    cost[y * width + x] = c;
+        }
+
+        std::vector<uint8_t> map(width * height * 4);
+        for(unsigned i=0; i < height; ++i) {
+            for(unsigned j=0; j < width; ++j) {
+                const unsigned pix_pos = ((height - i - 1) * width + j) << 2;
+                const auto level = uint8_t(max_cost > 0 ? colCap(255.99 * cost[i * width + j] / max_cost) : 0);
+                map[pix_pos + 0] = map[pix_pos + 1] = map[pix_pos + 2] = level;
+                map[pix_pos + 3] = 255u;
+            }
+        }
+        return map;
     }
 
 private:
+    // Gamma 2 by table: a value in [0, 1] is looked up by the top bits of its float, its exponent
+    // and first 8 bits of mantissa, which is within half a level of 255.99 * sqrt(v). Smaller
+    // exponents than the table's round to 0.
+    static constexpr unsigned lut_shift = 15;
+    static constexpr int32_t lut_first = (127 - 24) << 23, lut_last = 127 << 23; // bits of 2^-24 and 1
+
+    static const std::vector<uint8_t>& gamma_table() {
+        static const std::vector<uint8_t> table = [] {
+            std::vector<uint8_t> t(((lut_last - lut_first) >> lut_shift) + 1);
+            for(uint32_t k=0; k < t.size(); ++k) {
+                // The middle of the values sharing the bits, except 1 itself
+                const uint32_t bits = uint32_t(lut_first) + (k << lut_shift);
+                const float v = k + 1 == t.size() ? 1.f : std::bit_cast<float>(bits | (1u << (lut_shift - 1)));
+                t[k] = uint8_t(colCap(int(255.99 * std::sqrt(double(v)))));
+            }
+            return t;
+        }();
+        return table;
+    }
+
+    static void tonemap_row(const frame_planes& f, unsigned y, unsigned x0, unsigned n, uint8_t* out) {
+        const float* r = f.row(frame_planes::red, y) + x0;
+        const float* g = f.row(frame_planes::green, y) + x0;
+        const float* b = f.row(frame_planes::blue, y) + x0;
+        const float* ns = f.row(frame_planes::weight, y) + x0; // number of accumulated values
+        const uint8_t* table = gamma_table().data();
+        auto level = [table](float mean) {
+            // Clamped as bits, which order like the floats they are for all but negative NaNs;
+            // below the table's smallest, negatives included, is 0 and above 1 is 1
+            const int32_t bits = std::clamp(std::bit_cast<int32_t>(mean), lut_first, lut_last);
+            return table[uint32_t(bits - lut_first) >> lut_shift];
+        };
+        for(unsigned x=0; x < n; ++x) {
+            const float inv = 1 / std::max(ns[x], 1e-20f); // unsampled pixels have sums of 0 as well
+            const uint8_t rgba[4] = {level(r[x] * inv), level(g[x] * inv), level(b[x] * inv), 255u};
+            std::memcpy(out + 4 * x, rgba, 4);
+        }
+    }
+
     unsigned width{};
     unsigned height{};
-    std::vector<sf::Uint8> pix{}; // RGBA
+    std::vector<uint8_t> pix{}; // RGBA
 };
 
 #endif //RAYTRACING_PIXELS_HPP
@@ -0,0 +1,222 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#ifndef RAYTRACING_RENDERER_HPP
+#define RAYTRACING_RENDERER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "checkpoint.hpp"
+#include "task.hpp"
+#include "thread_pool.hpp"
+#include "topology.hpp"
+
+struct checkpoint_plan {
+    // Where and how often a render saves a checkpoint; an empty path for never
+    std::string path;
+    std::string label;       // stored in the checkpoint, e.g. the scene's name
+    float every_seconds{60};
+};
+
+class render_job {
+    // Handle to one render started by renderer::submit(). Any thread may poll it, look at the
+    // frame so far or cancel it while the workers run. With a checkpoint plan, a thread of its
+    // own saves the render periodically and once more if it is cancelled.
+public:
+    render_job(scene& _scn, const camera& _cam, checkpoint_plan _plan)
+            : scn{&_scn}, cam{_cam}, fb{params::WIDTH, params::HEIGHT}, plan{std::move(_plan)} {}
+
+    render_job(const render_job&) = delete;
+    render_job& operator=(const render_job&) = delete;
+
+    ~render_job() {
+        if(saver.joinable()) saver.join();
+    }
+
+    [[nodiscard]] float fraction_done() const { return prog.fraction_done(); }
+    // Seconds left, -1 while unknown
+    [[nodiscard]] float eta_seconds() const { return prog.eta_seconds(); }
+    // Seconds since the job started rendering, not counting its cost pre-pass
+    [[nodiscard]] float elapsed() const { return prog.elapsed(); }
+
+    [[nodiscard]] bool finished() const {
+        return done.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    // Workers stop after the tile they are on; the frame keeps what was committed by then
+    void cancel() { prog.stop = true; }
+    [[nodiscard]] bool cancelled() const { return prog.stop; }
+
+    void wait() const { done.wait(); }
+    // Waits and rethrows anything a worker threw
+    void get() const { done.get(); }
+    [[nodiscard]] const std::shared_future<void>& future() const { return done; }
+
+    // Copy of the frame so far, made between tile commits
+    void snapshot(frame_planes& out) const { fb.snapshot(out); }
+    [[nodiscard]] frame_planes snapshot() const { return fb.snapshot(); }
+
+    // Brings out, a copy of the frame, up to date by copying only the tiles that finished a pass
+    // since the last call, and calls changed(tile) for each. seen keeps the passes each tile
+    // had then and starts empty; out is sized to the frame. Tiles are final once the cost
+    // pre-pass is done, and nothing is committed before, so until then nothing changes.
+    template<typename F>
+    void refresh(frame_planes& out, std::vector<unsigned>& seen, F&& changed) const {
+        if(!prog.balanced.load(std::memory_order_acquire)) return;
+        if(out.width() != fb.width() || out.height() != fb.height()) out = frame_planes(fb.width(), fb.height());
+        seen.resize(prog.tiles.size(), 0);
+        for(unsigned i=0; i < seen.size(); ++i) {
+            // Counted before copying, so a pass finishing meanwhile is copied again next time
+            const unsigned passes = prog.tiles.passes_done(i);
+            if(passes == seen[i]) continue;
+            seen[i] = passes;
+            fb.snapshot(out, prog.tiles.tile(i));
+            changed(prog.tiles.tile(i));
+        }
+    }
+
+    // Final tiles with the time spent on each; only stable once the job has finished
+    [[nodiscard]] const tile_scheduler& tiles() const { return prog.tiles; }
+
+    // Checkpoints written so far
+    [[nodiscard]] unsigned checkpoints() const { return saved; }
+
+private:
+    scene* scn;
+    camera cam;
+    framebuffer fb;
+    progress prog;
+    std::shared_future<void> done;
+    checkpoint_plan plan;
+    std::thread saver;
+    std::atomic<unsigned> saved{0};
+    bool resumed{false};
+    std::shared_future<void> after; // the job submitted before this one on the same scene
+    std::once_flag started;
+    friend class renderer;
+
+    void start() {
+        // Runs once, in the job's first Task: waits for the job before it on the same scene to
+        // finish, then sets the scene up for this render and starts the clock
+        if(after.valid()) after.wait();
+        scn->build_lights();
+        // The guiding field trains over the first passes, which a resumed render skips
+        scn->guide = nullptr;
+        if(params::GUIDING && params::PROGRESSIVE && !resumed) {
+            aabb bounds;
+            scn->world.bounding_box(0, 1, bounds);
+            scn->guide = make_shared<guiding_field>(bounds, params::GUIDING_PASSES);
+        }
+        scn->cache = params::CACHE ? make_shared<radiance_cache>(params::CACHE_CELL, params::CACHE_DEPTH, params::CACHE_SAMPLES)
+                                   : nullptr;
+        prog.start_clock();
+    }
+
+    void save() {
+        // Tiles are only final once the cost pre-pass has rebalanced them
+        if(!prog.balanced.load(std::memory_order_acquire)) return;
+        checkpoint c;
+        c.label = plan.label;
+        c.capture(fb, prog);
+        if(c.write(plan.path)) ++saved;
+        else std::cerr << "Couldn't write checkpoint " << plan.path << std::endl;
+    }
+
+    void save_periodically() {
+        const auto every = std::chrono::duration<float>(std::max(plan.every_seconds, .1f));
+        while(done.wait_for(every) == std::future_status::timeout)
+            save();
+        if(prog.stop) save();
+    }
+};
+
+class renderer {
+    // Owns the render threads, which are created once and reused by every render. A render runs
+    // one Task per worker over the job's framebuffer and progress; jobs submitted while another
+    // runs start when it finishes.
+    //
+    // With pin, each worker is bound to a core, alternating between NUMA nodes. Workers allocate
+    // their tile buffers themselves, so those land on the worker's own node.
+public:
+    explicit renderer(unsigned threads = std::thread::hardware_concurrency(), bool pin = false)
+            : topo{cpu_topology::detect()}, pinned{pin},
+              pool{threads, [this](unsigned worker) { if(pinned) pin_current_thread(topo.cpu_for(worker)); }} {}
+
+    [[nodiscard]] unsigned threads() const { return pool.size(); }
+    [[nodiscard]] const cpu_topology& topology() const { return topo; }
+
+    [[nodiscard]] std::string placement() const {
+        std::string out = topo.report() + ". ";
+        if(!pinned)
+            return out + std::to_string(threads()) + " workers float freely.";
+        return out + std::to_string(threads()) + " workers pinned to cores alternately across nodes, "
+                   + "with tile buffers on their own node.";
+    }
+
+    // Starts rendering scn as seen from cam and returns at once. Settings are read from params.
+    // scn must outlive the job; the camera is copied. Its lights, guiding field and radiance
+    // cache are set up when the job starts, after any earlier job on scn has finished, so a
+    // scene may be submitted again while it renders. With resume, which must match the
+    // settings, the render carries on from that checkpoint.
+    std::shared_ptr<render_job> submit(scene& scn, const camera& cam, const checkpoint_plan& plan = {},
+                                       const checkpoint* resume = nullptr) {
+        auto job = std::make_shared<render_job>(scn, cam, plan);
+        progress& prog = job->prog;
+        job->resumed = resume != nullptr;
+        for(auto i = last_on.begin(); i != last_on.end();) {
+            if(i->second.wait_for(std::chrono::seconds(0)) == std::future_status::ready) i = last_on.erase(i);
+            else ++i;
+        }
+        if(auto i = last_on.find(&scn); i != last_on.end())
+            job->after = i->second;
+
+        prog.tiles.reset(params::WIDTH, params::HEIGHT, params::N, params::TILE_ORDER);
+        if(params::RESTIR && params::RESTIR_TEMPORAL) {
+            prog.reservoirs.resize(params::WIDTH * params::HEIGHT);
+            prog.shading_points.resize(params::WIDTH * params::HEIGHT);
+        }
+        prog.work_samples = float(params::PROGRESSIVE ? params::MAX_SAMPLES : params::N_samples);
+        prog.seed = (uint64_t(std::random_device{}()) << 32) | std::random_device{}();
+        if(resume)
+            resume->restore(job->fb, prog);
+        prog.work_total = prog.tiles.total_cost() * prog.work_samples;
+        if(params::COST_SPLIT && !resume) {
+            // Blocks a quarter of a tile across, so that a split tile still has measured parts
+            prog.cell = params::N % 4 ? params::N : params::N / 4;
+            prog.cell_cost.resize(((params::WIDTH + prog.cell - 1) / prog.cell) * ((params::HEIGHT + prog.cell - 1) / prog.cell));
+            prog.balance_units = 4 * threads();
+            prog.probing = threads();
+        }
+        else {
+            prog.balanced = true;
+        }
+
+        job->done = pool.run_on_all([job](unsigned worker) {
+            std::call_once(job->started, [&] { job->start(); });
+            Task{job->scn, &job->cam, &job->fb, &job->prog, int(worker)}();
+        }).share();
+        last_on[&scn] = job->done;
+        if(!plan.path.empty())
+            job->saver = std::thread([j = job.get()] { j->save_periodically(); });
+        return job;
+    }
+
+private:
+    cpu_topology topo;
+    bool pinned;
+    std::unordered_map<const scene*, std::shared_future<void>> last_on; // last unfinished job per scene
+    thread_pool pool; // last, so workers start once the members above are set
+};
+
+#endif //RAYTRACING_RENDERER_HPP
@@ -0,0 +1,237 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#ifndef RAYTRACING_SCHEDULER_HPP
+#define RAYTRACING_SCHEDULER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+enum class tile_order {
+    scanline,   // rows from the top, left to right
+    snake,      // rows from the top, alternating direction
+    hilbert,    // along a Hilbert curve, so consecutive tiles stay close together
+    centre_out  // nearest to the centre of the frame first
+};
+
+struct tile_rect {
+    unsigned x, y, w, h; // origin in pixels, row 0 at the bottom of the frame
+
+    [[nodiscard]] unsigned area() const { return w * h; }
+};
+
+class tile_scheduler {
+    // Hands out the tiles of a frame in a fixed order. The order is built once by reset(); after
+    // that next() is a single atomic increment, so threads never wait on each other. reset() and
+    // balance() must not run concurrently with anything else.
+    //
+    // Renders that visit every tile several times count finished passes per tile, so that a
+    // tile's next pass never overlaps the previous one. Every tile also has an estimated cost per
+    // sample, its area until balance() measures better, and the render time spent on it so far.
+public:
+    void reset(unsigned width, unsigned height, unsigned tile_size, tile_order order) {
+        frame_w = width;
+        frame_h = height;
+        const unsigned w_cnt = (width + tile_size - 1) / tile_size;
+        const unsigned h_cnt = (height + tile_size - 1) / tile_size;
+        std::vector<std::pair<unsigned, unsigned>> grid; // (column, row)
+        for(unsigned row=h_cnt; row-- > 0;)
+            for(unsigned col=0; col < w_cnt; ++col)
+                grid.emplace_back(col, row);
+
+        switch(order) {
+            case tile_order::scanline:
+                break;
+            case tile_order::snake:
+                for(auto& [col, row] : grid)
+                    if((h_cnt - 1 - row) % 2) col = w_cnt - 1 - col;
+                break;
+            case tile_order::hilbert: {
+                unsigned n = 1;
+                while(n < std::max(w_cnt, h_cnt)) n *= 2;
+                std::stable_sort(grid.begin(), grid.end(), [n](const auto& a, const auto& b) {
+                    return hilbert_index(n, a.first, a.second) < hilbert_index(n, b.first, b.second);
+                });
+                break;
+            }
+            case tile_order::centre_out: {
+                const float cx = float(w_cnt - 1) / 2, cy = float(h_cnt - 1) / 2;
+                auto dist2 = [cx, cy](const std::pair<unsigned, unsigned>& t) {
+                    const float dx = float(t.first) - cx, dy = float(t.second) - cy;
+                    return dx*dx + dy*dy;
+                };
+                std::stable_sort(grid.begin(), grid.end(), [&](const auto& a, const auto& b) {
+                    return dist2(a) < dist2(b);
+                });
+                break;
+            }
+        }
+
+        tiles.clear();
+        costs.clear();
+        for(auto [col, row] : grid) {
+            const unsigned x = col * tile_size, y = row * tile_size;
+            tiles.push_back({x, y, std::min(tile_size, width - x), std::min(tile_size, height - y)});
+            costs.push_back(float(tiles.back().area()));
+        }
+        restart();
+    }
+
+    void balance(std::vector<float> cell_cost, unsigned cell, unsigned units) {
+        // Splits tiles in halves along their longer side until none costs more than 1/units of
+        // the frame or they are one cell across, then orders them longest first. cell_cost holds
+        // the measured cost per sample of every cell*cell block of the frame, whose grid the
+        // tiles must be aligned to. The tiles are handed out again from the first either way.
+        if(cell_cost.empty()) {
+            restart();
+            return;
+        }
+        const unsigned cells_w = (frame_w + cell - 1) / cell;
+
+        // Single timed samples are noisy and a preempted thread can make one look a thousand
+        // times slower, so no cell may cost more than max_outlier times the median
+        std::vector<float> sorted = cell_cost;
+        std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+        const float cap = max_outlier * sorted[sorted.size() / 2];
+        if(cap > 0)
+            for(float& c : cell_cost) c = fmin(c, cap);
+
+        auto cost_of = [&](const tile_rect& t) {
+            float c = 0;
+            for(unsigned y=t.y; y < t.y + t.h; y += cell)
+                for(unsigned x=t.x; x < t.x + t.w; x += cell)
+                    c += cell_cost[(y / cell) * cells_w + x / cell];
+            return c;
+        };
+        float total = 0;
+        for(float c : cell_cost) total += c;
+        if(!(total > 0)) {
+            restart();
+            return;
+        }
+        const float target = total / float(std::max(units, 1u));
+
+        std::vector<std::pair<tile_rect, float>> out;
+        std::vector<tile_rect> stack(tiles.rbegin(), tiles.rend());
+        while(!stack.empty()) {
+            const tile_rect t = stack.back();
+            stack.pop_back();
+            const float c = cost_of(t);
+            const bool wide = t.w >= t.h;
+            const unsigned side = wide ? t.w : t.h;
+            if(c <= target || side <= cell) {
+                out.emplace_back(t, c);
+                continue;
+            }
+            const unsigned half = std::max(cell, side / 2 / cell * cell);
+            tile_rect a = t, b = t;
+            if(wide) {
+                a.w = half;
+                b.x += half;
+                b.w -= half;
+            }
+            else {
+                a.h = half;
+                b.y += half;
+                b.h -= half;
+            }
+            stack.push_back(b);
+            stack.push_back(a);
+        }
+        std::stable_sort(out.begin(), out.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+
+        tiles.clear();
+        costs.clear();
+        for(auto& [t, c] : out) {
+            tiles.push_back(t);
+            costs.push_back(c);
+        }
+        restart();
+    }
+
+    // Takes the tiles and costs of an earlier frame, e.g. to resume it, then restarts
+    void assign(unsigned width, unsigned height, std::vector<tile_rect> _tiles, std::vector<float> _costs) {
+        frame_w = width;
+        frame_h = height;
+        tiles = std::move(_tiles);
+        costs = std::move(_costs);
+        costs.resize(tiles.size());
+        restart();
+    }
+
+    // Hands the tiles out again from the first, with no passes or time recorded
+    void restart() {
+        next_tile.store(0, std::memory_order_relaxed);
+        passes = std::make_unique<std::atomic<unsigned>[]>(tiles.size());
+        times = std::make_unique<std::atomic<float>[]>(tiles.size());
+    }
+
+    [[nodiscard]] unsigned size() const { return unsigned(tiles.size()); }
+    [[nodiscard]] unsigned width() const { return frame_w; }
+    [[nodiscard]] unsigned height() const { return frame_h; }
+
+    // i-th tile in order
+    [[nodiscard]] const tile_rect& tile(unsigned i) const { return tiles[i]; }
+
+    [[nodiscard]] float cost(unsigned i) const { return costs[i]; }
+    [[nodiscard]] float total_cost() const {
+        float c = 0;
+        for(float x : costs) c += x;
+        return c;
+    }
+
+    [[nodiscard]] unsigned passes_done(unsigned i) const { return passes[i].load(std::memory_order_acquire); }
+    void finish_pass(unsigned i) { passes[i].fetch_add(1, std::memory_order_release); }
+    void set_passes(unsigned i, unsigned n) { passes[i].store(n, std::memory_order_release); }
+    // Passes every tile has finished, i.e. whole passes over the frame
+    [[nodiscard]] unsigned frame_passes() const {
+        unsigned n = ~0u;
+        for(unsigned i=0; i < tiles.size(); ++i) n = std::min(n, passes_done(i));
+        return tiles.empty() ? 0 : n;
+    }
+
+    // Render time spent on tile i, in seconds
+    [[nodiscard]] float time(unsigned i) const { return times[i].load(std::memory_order_relaxed); }
+    void add_time(unsigned i, float seconds) { times[i].fetch_add(seconds, std::memory_order_relaxed); }
+
+    // Claims the next tile of the frame; false once all have been handed out
+    bool next(unsigned& i) {
+        i = next_tile.fetch_add(1, std::memory_order_relaxed);
+        return i < tiles.size();
+    }
+
+private:
+    static constexpr float max_outlier = 16;
+
+    unsigned frame_w{0}, frame_h{0};
+    std::vector<tile_rect> tiles;
+    std::vector<float> costs;
+    std::atomic<unsigned> next_tile{0};
+    std::unique_ptr<std::atomic<unsigned>[]> passes;
+    std::unique_ptr<std::atomic<float>[]> times;
+
+    static uint64_t hilbert_index(unsigned n, unsigned x, unsigned y) {
+        // Distance of (x, y) along the Hilbert curve filling an n*n grid, n a power of two
+        uint64_t d = 0;
+        for(unsigned s=n/2; s > 0; s /= 2) {
+            const unsigned rx = (x & s) > 0, ry = (y & s) > 0;
+            d += uint64_t(s) * s * ((3 * rx) ^ ry);
+            if(ry == 0) {
+                if(rx == 1) {
+                    x = n - 1 - x;
+                    y = n - 1 - y;
+                }
+                std::swap(x, y);
+            }
+        }
+        return d;
+    }
+};
+
+#endif //RAYTRACING_SCHEDULER_HPP
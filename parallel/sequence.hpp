@@ -0,0 +1,134 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#ifndef RAYTRACING_SEQUENCE_HPP
+#define RAYTRACING_SEQUENCE_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "framebuffer.hpp"
+#include "renderer.hpp"
+#include "scene_select.hpp"
+
+class sequence_renderer {
+    // Renders frames one after another as a pipeline. While frame n renders, frame n+1's scene
+    // is built on a thread of its own and frame n-1 is finished (denoised, encoded, written) on
+    // another. A frame is submitted as soon as it is built, so its Tasks queue behind the
+    // previous frame's and each render thread moves on as soon as it runs out of tiles, rather
+    // than waiting for the slowest tile of the frame.
+    //
+    // At most in_flight frames are submitted and not yet finished, which bounds memory to that
+    // many scenes and framebuffers plus the one being built.
+public:
+    using build_fn = std::function<scene_setup(unsigned frame)>;
+    using finish_fn = std::function<void(unsigned frame, frame_planes& image)>;
+
+    sequence_renderer(renderer& _rend, build_fn _build, finish_fn _finish, unsigned _in_flight = 3)
+            : rend{_rend}, build{std::move(_build)}, finish{std::move(_finish)}, in_flight{std::max(_in_flight, 1u)} {}
+
+    // Renders frames [first, first + count); rethrows the first exception of any stage
+    void run(unsigned first, unsigned count) {
+        if(count == 0) return;
+        done = false;
+        error = nullptr;
+        std::thread finisher([this] { finish_frames(); });
+
+        std::future<scene_setup> next = std::async(std::launch::async, build, first);
+        for(unsigned f=first; f < first + count && !failed(); ++f) {
+            auto setup = std::make_unique<scene_setup>();
+            try {
+                *setup = next.get();
+            }
+            catch(...) {
+                fail(std::current_exception());
+                break;
+            }
+            if(f + 1 < first + count)
+                next = std::async(std::launch::async, build, f + 1);
+
+            std::unique_lock<std::mutex> lock{m};
+            changed.wait(lock, [this] { return pending.size() < in_flight || error; });
+            if(error) break;
+            lock.unlock();
+            auto job = rend.submit(setup->scn, setup->make_camera());
+            lock.lock();
+            pending.push_back({f, std::move(setup), std::move(job)});
+            changed.notify_all();
+        }
+        if(next.valid()) next.wait();
+
+        {
+            std::lock_guard<std::mutex> lock{m};
+            done = true;
+        }
+        changed.notify_all();
+        finisher.join();
+        if(error) std::rethrow_exception(error);
+    }
+
+private:
+    struct frame {
+        unsigned index;
+        std::unique_ptr<scene_setup> setup; // outlives the job rendering it
+        std::shared_ptr<render_job> job;
+    };
+
+    renderer& rend;
+    build_fn build;
+    finish_fn finish;
+    unsigned in_flight;
+
+    std::mutex m;
+    std::condition_variable changed;
+    std::deque<frame> pending; // submitted, in order, until finished
+    bool done{false};
+    std::exception_ptr error;
+
+    bool failed() {
+        std::lock_guard<std::mutex> lock{m};
+        return bool(error);
+    }
+
+    void fail(std::exception_ptr e) {
+        std::lock_guard<std::mutex> lock{m};
+        if(!error) error = e;
+        for(auto& p : pending) p.job->cancel();
+        changed.notify_all();
+    }
+
+    void finish_frames() {
+        while(true) {
+            std::unique_lock<std::mutex> lock{m};
+            changed.wait(lock, [this] { return !pending.empty() || done; });
+            if(pending.empty()) return;
+            frame& f = pending.front();
+            lock.unlock();
+
+            // Waiting here leaves the render threads to the frames behind this one
+            try {
+                f.job->get();
+                if(!failed()) {
+                    frame_planes image = f.job->snapshot();
+                    finish(f.index, image);
+                }
+            }
+            catch(...) {
+                fail(std::current_exception());
+            }
+
+            lock.lock();
+            pending.pop_front();
+            changed.notify_all();
+        }
+    }
+};
+
+#endif //RAYTRACING_SEQUENCE_HPP
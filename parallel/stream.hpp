@@ -0,0 +1,226 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#ifndef RAYTRACING_STREAM_HPP
+#define RAYTRACING_STREAM_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "checkpoint.hpp"
+#include "image_output.hpp"
+#include "scheduler.hpp"
+#include "task.hpp"
+#include "thread_pool.hpp"
+
+// Renders too large to hold in memory. Tiles are rendered to completion in bands from the top
+// and each is written into an EXR on disk as it finishes, so memory holds the tiles in flight
+// rather than the frame. An index next to the image, path + ".tiles", records the finished
+// tiles; a render that stops leaves both behind and a later one with the same settings skips
+// what is done.
+
+class streamed_exr {
+    // The image, laid out as exr_layout has it and sized in full when created, and its index:
+    // a header like a checkpoint's and then one byte per tile, set once the tile is written.
+public:
+    streamed_exr() = default;
+    streamed_exr(const streamed_exr&) = delete;
+    streamed_exr& operator=(const streamed_exr&) = delete;
+
+    ~streamed_exr() { close(); }
+
+    // Opens path for a render of the current settings, carrying on from its index if resume
+    // is set and the index is from the same render. Otherwise starts afresh with seed. False
+    // with the reason in why if neither works.
+    bool open(const std::string& _path, const std::string& label, uint64_t _seed, bool resume, std::string& why) {
+        close();
+        path = _path;
+        w = params::WIDTH;
+        h = params::HEIGHT;
+        tiles.reset(w, h, params::N, tile_order::scanline);
+        head = exr_layout::header(w, h);
+        done.assign(tiles.size(), 0);
+        written = 0;
+
+        // The index header; the seed goes last, so that what comes before it says which render this is
+        std::string expected(magic, sizeof magic);
+        const auto settings = checkpoint::current_settings();
+        const auto n = uint32_t(label.size());
+        expected.append(reinterpret_cast<const char*>(&n), sizeof n).append(label);
+        expected.append(reinterpret_cast<const char*>(&settings), sizeof settings);
+
+        if(resume && (index_fd = ::open((path + ".tiles").c_str(), O_RDWR)) >= 0) {
+            std::string found(expected.size(), '\0');
+            const bool same = ::pread(index_fd, found.data(), found.size(), 0) == ssize_t(found.size()) && found == expected
+                              && ::pread(index_fd, &seed, sizeof seed, off_t(found.size())) == ssize_t(sizeof seed);
+            index_start = off_t(expected.size() + sizeof seed);
+            if(!same || ::pread(index_fd, done.data(), done.size(), index_start) != ssize_t(done.size())) {
+                why = path + ".tiles is from a different scene or settings";
+                close();
+                return false;
+            }
+            if((fd = ::open(path.c_str(), O_RDWR)) < 0 || file_size() != expected_size()) {
+                why = path + " is missing or not the image its index belongs to";
+                close();
+                return false;
+            }
+            written = unsigned(std::count(done.begin(), done.end(), 1));
+            return true;
+        }
+
+        seed = _seed;
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if(fd < 0 || !put(fd, head.data(), head.size(), 0) || ::ftruncate(fd, off_t(expected_size())) != 0) {
+            why = "Couldn't create " + path;
+            close();
+            return false;
+        }
+        // Every scanline starts with its number and size; the pixels come as tiles finish
+        for(unsigned y=0; y < h; ++y) {
+            std::string prefix;
+            image_detail::put_le(prefix, int32_t(y));
+            image_detail::put_le(prefix, int32_t(exr_layout::chunk_bytes(w) - 8));
+            if(!put(fd, prefix.data(), prefix.size(), line(y))) {
+                why = "Couldn't write " + path;
+                close();
+                return false;
+            }
+        }
+        expected.append(reinterpret_cast<const char*>(&seed), sizeof seed);
+        index_start = off_t(expected.size());
+        index_fd = ::open((path + ".tiles").c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if(index_fd < 0 || !put(index_fd, expected.data(), expected.size(), 0)
+           || !put(index_fd, done.data(), done.size(), index_start)) {
+            why = "Couldn't create " + path + ".tiles";
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    [[nodiscard]] uint64_t random_seed() const { return seed; }
+    [[nodiscard]] unsigned size() const { return tiles.size(); }
+    [[nodiscard]] const tile_rect& tile(unsigned i) const { return tiles.tile(i); }
+    [[nodiscard]] bool finished(unsigned i) const { return done[i] != 0; }
+    [[nodiscard]] unsigned finished_count() const { return written; }
+
+    // Writes tile i from the accumulated planes of a task that rendered it, then marks it done.
+    // Threads may write different tiles at once.
+    bool write(unsigned i, const frame_planes& f) {
+        const tile_rect& t = tiles.tile(i);
+        std::string v;
+        v.reserve(t.w * sizeof(float));
+        for(unsigned row=t.y; row < t.y + t.h; ++row) {
+            const float* n = f.row(frame_planes::weight, row);
+            for(unsigned c=0; c < exr_layout::channels; ++c) {
+                const int p = exr_layout::planes[c];
+                const float* s = f.row(p, row);
+                v.clear();
+                for(unsigned x=0; x < t.w; ++x)
+                    image_detail::put_le(v, p == frame_planes::weight ? n[x] : n[x] > 0 ? s[x] / n[x] : 0.f);
+                const uint64_t at = line(h - 1 - row) + 8 + (uint64_t(c) * w + t.x) * sizeof(float);
+                if(!put(fd, v.data(), v.size(), at)) return false;
+            }
+        }
+        // Only after the pixels, so that the index never runs ahead of the image
+        done[i] = 1;
+        if(!put(index_fd, &done[i], 1, index_start + off_t(i))) return false;
+        ++written;
+        return true;
+    }
+
+    // Once every tile is written: the image is complete and the index goes
+    bool finish() {
+        if(fd < 0 || written != size()) return false;
+        close();
+        std::remove((path + ".tiles").c_str());
+        return true;
+    }
+
+private:
+    static constexpr char magic[8] = {'R', 'T', 'T', 'I', 'L', 'E', '0', '1'};
+
+    std::string path, head;
+    unsigned w{0}, h{0};
+    tile_scheduler tiles;
+    std::vector<uint8_t> done;
+    std::atomic<unsigned> written{0};
+    uint64_t seed{0};
+    int fd{-1}, index_fd{-1};
+    off_t index_start{0};
+
+    [[nodiscard]] uint64_t line(unsigned y) const { return head.size() + uint64_t(y) * exr_layout::chunk_bytes(w); }
+    [[nodiscard]] uint64_t expected_size() const { return line(h); }
+
+    [[nodiscard]] uint64_t file_size() const {
+        const off_t end = ::lseek(fd, 0, SEEK_END);
+        return end < 0 ? 0 : uint64_t(end);
+    }
+
+    static bool put(int to, const void* data, size_t n, uint64_t at) {
+        auto p = static_cast<const char*>(data);
+        while(n > 0) {
+            const ssize_t k = ::pwrite(to, p, n, off_t(at));
+            if(k < 0 && errno == EINTR) continue;
+            if(k <= 0) return false;
+            p += k;
+            at += uint64_t(k);
+            n -= size_t(k);
+        }
+        return true;
+    }
+
+    void close() {
+        if(fd >= 0) ::close(fd);
+        if(index_fd >= 0) ::close(index_fd);
+        fd = index_fd = -1;
+    }
+};
+
+inline bool render_streamed(scene& scn, const camera& _cam, unsigned threads, streamed_exr& out,
+                            const std::function<bool()>& poll = {}) {
+    // Renders the tiles out has not got yet, N_samples per pixel each, on threads of its own and
+    // writes each as it finishes. Calls poll about once a second and stops after the tiles in
+    // flight once it returns false. True if every tile is written.
+    scn.build_lights();
+    camera cam = _cam;
+    progress prog;
+    prog.seed = out.random_seed();
+    std::atomic<unsigned> next{0};
+    std::atomic<bool> failed{false};
+    thread_pool pool{threads};
+    auto done = pool.run_on_all([&](unsigned worker) {
+        Task task{&scn, &cam, nullptr, &prog, int(worker)};
+        while(!prog.stop) {
+            const unsigned i = next++;
+            if(i >= out.size()) break;
+            if(out.finished(i)) continue;
+            task.set_rect(out.tile(i));
+            seed_random(prog.seed, i);
+            for(unsigned s=0; s < params::N_samples; ++s)
+                task.sample_tile();
+            if(!out.write(i, task.acc.local())) {
+                failed = true;
+                prog.stop = true;
+            }
+        }
+    });
+    while(done.wait_for(std::chrono::seconds(1)) != std::future_status::ready)
+        if(poll && !poll()) prog.stop = true;
+    done.get();
+    return !failed && out.finished_count() == out.size();
+}
+
+#endif //RAYTRACING_STREAM_HPP
@@ -5,100 +5,445 @@
 #ifndef RAYTRACING_TASK_HPP
 #define RAYTRACING_TASK_HPP
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>
+#include <thread>
 #include <vector>
 
+#include "framebuffer.hpp"
 #include "params.hpp"
+#include "scheduler.hpp"
+#include "timer.hpp"
+#include "sampling/reservoir.hpp"
 
-std::atomic<unsigned> done_count;
+struct progress {
+    // Shared state of a render. The scheduler hands out tiles; progressive work units are
+    // (pass, tile) pairs in pass order, with tiles in the scheduler's order. A tile's pass counts
+    // as finished once its samples are in the frame, and units that were finished before a
+    // resume are skipped.
+    tile_scheduler tiles;
+    uint64_t seed{0}; // unit u samples random stream (seed, u), so a resumed unit repeats it
+    std::atomic<unsigned> next_unit{0};
+    std::atomic<unsigned> passes_seen{0}; // whole passes handled after they finished, see render_progressive
+    std::atomic<bool> stop{false};
+    // When the render started, as steady_clock ticks, 0 until then. Set once the job's first Task
+    // runs and again after the cost pre-pass, so neither the queue nor the probe counts.
+    std::atomic<std::chrono::steady_clock::rep> started{0};
+    std::atomic<float> work_done{0}; // estimated cost of the finished units, in tile cost units
+    std::atomic<float> work_total{0}; // estimated cost of the whole render, known once tiles are final
+    float work_samples{0};           // samples per pixel the render aims for
+    // Last reservoir of each pixel and the primary hit it belongs to, for temporal reuse with RESTIR
+    std::vector<reservoir> reservoirs;
+    std::vector<shading_point> shading_points;
+    // Cost pre-pass with COST_SPLIT: block costs measured by every worker, the number of workers
+    // still measuring, and whether the last of them has rebalanced the tiles
+    std::vector<float> cell_cost;
+    unsigned cell{0};
+    unsigned balance_units{0};
+    std::atomic<unsigned> probing{0};
+    std::atomic<bool> balanced{false};
+
+    void start_clock() { started.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed); }
+
+    [[nodiscard]] float elapsed() const {
+        // Seconds since start_clock()
+        const auto t = started.load(std::memory_order_relaxed);
+        if(t == 0) return 0;
+        const std::chrono::steady_clock::time_point start{std::chrono::steady_clock::duration{t}};
+        return std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    [[nodiscard]] float fraction_done() const {
+        const float total = work_total.load(std::memory_order_relaxed);
+        float f = total > 0 ? fmin(work_done.load(std::memory_order_relaxed) / total, 1.f) : 0;
+        if(params::PROGRESSIVE && params::TIME_BUDGET)
+            f = fmax(f, fmin(elapsed() * 1000 / float(params::TIME_BUDGET), 1.f));
+        return f;
+    }
+
+    [[nodiscard]] float eta_seconds() const {
+        // Remaining time if the rest of the work goes at the pace of the finished part, -1 if unknown
+        const float seconds = elapsed();
+        const float done = work_done.load(std::memory_order_relaxed);
+        const float total = work_total.load(std::memory_order_relaxed);
+        float eta = done > 0 && total > 0 ? seconds * fmax(total - done, 0.f) / done : -1;
+        if(params::PROGRESSIVE && params::TIME_BUDGET) {
+            const float left = fmax(float(params::TIME_BUDGET) / 1000 - seconds, 0.f);
+            eta = eta < 0 ? left : fmin(eta, left);
+        }
+        return eta;
+    }
+};
 
 class Task {
 public:
-    Task(hittable_list* w, camera* c, color& back, float* d)
-            : my_id{id++}, world{w},
-              cam{c}, background(back), data{d}
+    Task(scene* s, camera* c, framebuffer* f, progress* p, int worker = 0)
+            : my_id{worker}, scn{s},
+              cam{c}, fb{f}, prog{p}
     {}
 
-    static void move_in_pattern(int& rx, int& ry) {
-        // snake pattern implementation
-        static int x = -1, y = int(params::H_CNT) - 1;
-        static bool dir = false;
+    bool get_next_task() {
+        unsigned i;
+        do {
+            if(!prog->tiles.next(i)) return false;
+        } while(prog->tiles.passes_done(i) > 0);
+        set_tile(i);
+        seed_random(prog->seed, i);
+        return true;
+    }
+
+    void set_tile(unsigned i) {
+        tile = i;
+        set_rect(prog->tiles.tile(i));
+    }
+
+    // Points the task at any part of the frame, for work that does not come from prog->tiles
+    void set_rect(const tile_rect& t) {
+        sx = int(t.x);
+        sy = int(t.y);
+        tw = t.w;
+        th = t.h;
+        acc.reset(t);
+    }
 
-        x = dir ? x - 1 : x + 1;
-        if(x == params::W_CNT || x == -1) {
-            x = x == -1 ? 0 : params::W_CNT - 1;
-            y--;
-            dir = !dir;
+    template<typename F>
+    void timed(unsigned samples, F&& work) {
+        // Runs work on the current tile, commits its samples as one more finished pass, then books
+        // its time and estimated cost
+        const Timer t;
+        work();
+        fb->commit(acc, [this] { prog->tiles.finish_pass(tile); });
+        prog->tiles.add_time(tile, t.elapsed());
+        prog->work_done.fetch_add(prog->tiles.cost(tile) * float(samples), std::memory_order_relaxed);
+    }
+
+    void probe_costs(std::vector<float>& cell_cost, unsigned cell) {
+        // One timed sample at a random pixel of every cell*cell block in the tiles this task
+        // claims, scaled to the block's area. Nothing is accumulated.
+        const unsigned cells_w = (params::WIDTH + cell - 1) / cell;
+        unsigned i;
+        while(prog->tiles.next(i)) {
+            set_tile(i);
+            for(unsigned y=sy; y < sy + th; y += cell) {
+                for(unsigned x=sx; x < sx + tw; x += cell) {
+                    const unsigned w = std::min(cell, params::WIDTH - x), h = std::min(cell, params::HEIGHT - y);
+                    const unsigned px = x + std::min(unsigned(random_float() * float(w)), w - 1);
+                    const unsigned py = y + std::min(unsigned(random_float() * float(h)), h - 1);
+                    const Timer t;
+                    ray_color2(pixel_ray(px, py), *scn, params::MAX_DEPTH, params::RR_DEPTH);
+                    cell_cost[(y / cell) * cells_w + x / cell] = t.elapsed() * float(w * h);
+                }
+            }
         }
-        rx = x;
-        ry = y;
     }
 
-    bool get_next_task() {
-        static std::vector<std::vector<bool>> taken(params::H_CNT, std::vector<bool>(params::W_CNT));
-        static std::mutex m;
-
-        std::lock_guard<std::mutex> guard{m};
-
-        bool found = false;
-        int x, y;
-        while(!found) {
-            move_in_pattern(x, y);
-            if(x < 0 || x > params::W_CNT || y < 0 || y > params::H_CNT) break;
-
-            if(!taken[y][x]) {
-                sx = x * int(params::N);
-                sy = y * int(params::N);
-                taken[y][x] = true;
-                found = true;
+    [[nodiscard]] ray pixel_ray(unsigned x, unsigned y) const {
+        const auto u = (float)((x + random_float()) / (params::WIDTH));
+        const auto v = (float)((y + random_float()) / (params::HEIGHT));
+        return cam->get_ray(u, v);
+    }
+
+    void sample_pixel(unsigned x, unsigned y) {
+        accumulate(x, y, ray_color2(pixel_ray(x, y), *scn, params::MAX_DEPTH, params::RR_DEPTH));
+    }
+
+    void accumulate(unsigned x, unsigned y, const color& col) {
+        acc.add(x, y, col);
+    }
+
+    static float relative_error(const frame_planes& f, unsigned x, unsigned y) {
+        // Standard error of the mean luminance over the mean, from the running sums.
+        const float n = f.samples(x, y);
+        if(n < 2) return f_infinity;
+        const float mean = luminance(f.sum(x, y)) / n;
+        const float var = fmax(f.at(frame_planes::sq_lum, x, y) / n - mean * mean, .0f) * n / (n - 1);
+        return sqrtf(var / n) / (mean + .01f);
+    }
+
+    [[nodiscard]] bool resampling() const {
+        return params::RESTIR && scn->media.empty() && !scn->lights.empty();
+    }
+
+    void sample_tile() {
+        // One sample for every pixel of the tile
+        if(resampling()) {
+            sample_tile_resampled();
+            return;
+        }
+        for(unsigned y=sy; y < sy + th; ++y) {
+            for(unsigned x=sx; x < sx + tw; ++x) {
+                if(x >= params::WIDTH || y >= params::HEIGHT) continue;
+                sample_pixel(x, y);
+            }
+        }
+    }
+
+    void sample_tile_resampled() {
+        // Direct light at the primary hits comes from reservoirs: RESTIR_CANDIDATES light samples
+        // per pixel, combined with the pixel's reservoir from its previous sample and then with a
+        // few similar neighbours in the tile, and finally one shadow ray each.
+        const unsigned n = tw * th;
+        std::vector<shading_point> px(n);
+        std::vector<bool> inside(n);
+        std::vector<reservoir> res(n);
+
+        for(unsigned i=0; i < n; ++i) {
+            const unsigned x = sx + i % tw, y = sy + i / tw;
+            if(x >= params::WIDTH || y >= params::HEIGHT) continue;
+            shading_point& p = px[i];
+            inside[i] = true;
+            p.r = pixel_ray(x, y);
+            scatter_record srec;
+            p.valid = scn->world.hit(p.r, 0.001f, f_infinity, p.rec) && p.rec.mat_ptr->scatter(p.r, p.rec, srec)
+                      && !srec.is_specular && p.rec.normal.length_squared() > 0;
+            if(!p.valid) continue;
+            p.albedo = srec.attenuation;
+
+            res[i] = light_candidates(*scn, p.r, p.rec, p.albedo, int(params::RESTIR_CANDIDATES));
+            const unsigned pix = y * params::WIDTH + x;
+            if(params::RESTIR_TEMPORAL && !prog->reservoirs.empty() && prog->shading_points[pix].valid) {
+                reservoir prev = prog->reservoirs[pix];
+                prev.M = fmin(prev.M, 20 * res[i].M); // bounds how long stale history keeps its say
+                const shading_point* pts[] = {&p, &prog->shading_points[pix]};
+                const reservoir* rs[] = {&res[i], &prev};
+                res[i] = combine_reservoirs(pts, rs, 2);
+            }
+        }
+
+        // Spatial reuse reads the reservoirs above and writes new ones, so order does not matter
+        std::vector<reservoir> reused = res;
+        constexpr int radius = 4;
+        const shading_point* pts[1 + 16];
+        const reservoir* rs[1 + 16];
+        const unsigned neighbours = std::min(params::RESTIR_NEIGHBOURS, 16u);
+        for(unsigned i=0; i < n && neighbours > 0; ++i) {
+            const shading_point& p = px[i];
+            if(!p.valid) continue;
+            int count = 0;
+            pts[count] = &p;
+            rs[count++] = &res[i];
+            for(unsigned k=0; k < neighbours; ++k) {
+                const int nx = std::clamp(int(i % tw) + int(random_float(-radius, radius + 1)), 0, int(tw) - 1);
+                const int ny = std::clamp(int(i / tw) + int(random_float(-radius, radius + 1)), 0, int(th) - 1);
+                const unsigned j = ny * tw + nx;
+                const shading_point& q = px[j];
+                if(j == i || !q.valid || dot(p.rec.normal, q.rec.normal) < .9f || fabs(q.rec.t - p.rec.t) > .1f * p.rec.t)
+                    continue;
+                pts[count] = &q;
+                rs[count++] = &res[j];
+            }
+            if(count > 1)
+                reused[i] = combine_reservoirs(pts, rs, count);
+        }
+
+        for(unsigned i=0; i < n; ++i) {
+            if(!inside[i]) continue;
+            const shading_point& p = px[i];
+            const unsigned x = sx + i % tw, y = sy + i / tw;
+            // The path retraces the primary ray but leaves emitter lighting at its hit to the reservoir
+            color col = ray_color2(p.r, *scn, params::MAX_DEPTH, params::RR_DEPTH, false);
+            if(p.valid)
+                col += shade_reservoir(*scn, p.r, p.rec, p.albedo, reused[i]);
+            if(!prog->reservoirs.empty()) {
+                prog->reservoirs[y * params::WIDTH + x] = reused[i];
+                prog->shading_points[y * params::WIDTH + x] = p;
+            }
+            accumulate(x, y, col);
+        }
+    }
+
+    void render_tile() {
+        for(unsigned s=0; s < params::N_samples; ++s)
+            sample_tile();
+    }
+
+    void render_tile_adaptive() {
+        // The tile gets N_samples per pixel on average. Pixels are sampled in rounds of
+        // MIN_SAMPLES and drop out once converged, leaving the rest of the budget to noisy ones.
+        std::vector<std::pair<unsigned, unsigned>> active;
+        for(unsigned y=sy; y < sy + th; ++y)
+            for(unsigned x=sx; x < sx + tw; ++x)
+                if(x < params::WIDTH && y < params::HEIGHT) active.emplace_back(x, y);
+
+        long budget = long(active.size()) * params::N_samples;
+        unsigned spp = 0;
+        while(!active.empty() && budget > 0 && spp < params::MAX_SAMPLES) {
+            // At least a sample a round, or with MIN_SAMPLES of 0 no pixel would ever converge
+            const unsigned round = std::min(std::max(params::MIN_SAMPLES, 1u), params::MAX_SAMPLES - spp);
+            for(auto [x, y] : active)
+                for(unsigned s=0; s < round; ++s) sample_pixel(x, y);
+            budget -= long(active.size()) * round;
+            spp += round;
+
+            // The tile is ours, so its committed pixels can be read without the frame lock
+            fb->commit(acc);
+            const frame_planes& f = fb->owned();
+            std::erase_if(active, [&f](auto& p) { return relative_error(f, p.first, p.second) < params::MAX_ERROR; });
+        }
+    }
+
+    [[nodiscard]] float frame_error() const {
+        // Mean relative error over the pixels that have enough samples to estimate it
+        const frame_planes f = fb->snapshot();
+        float sum = 0;
+        unsigned n = 0;
+        for(unsigned y=0; y < params::HEIGHT; ++y) {
+            for(unsigned x=0; x < params::WIDTH; ++x) {
+                const float err = relative_error(f, x, y);
+                if(err == f_infinity) continue;
+                sum += err;
+                ++n;
             }
         }
+        return n ? sum / float(n) : f_infinity;
+    }
+
+    bool start_unit(unsigned unit) {
+        // Points the task at the unit's tile once the tile's previous pass has finished.
+        // False if the render was stopped while waiting.
+        const unsigned n_tiles = prog->tiles.size();
+        const unsigned tile = unit % n_tiles;
+        while(prog->tiles.passes_done(tile) < unit / n_tiles) {
+            if(prog->stop) return false;
+            std::this_thread::yield();
+        }
+        set_tile(tile);
+        seed_random(prog->seed, unit);
+        return true;
+    }
 
-        return found;
+    [[nodiscard]] bool finished_before(unsigned unit) const {
+        // A unit's pass can only have finished before it was claimed in an earlier render
+        const unsigned n_tiles = prog->tiles.size();
+        return unit / n_tiles < prog->tiles.passes_done(unit % n_tiles);
+    }
+
+    void render_interleaved() {
+        // Tiled render of N_samples per pixel in (pass, tile) units, where pass k adds samples
+        // [2^(k-1), 2^k) to a tile: the whole frame gets 1 spp, then 2, 4 and so on, while each
+        // unit still works on one tile.
+        const unsigned n_tiles = prog->tiles.size();
+        while(!prog->stop) {
+            const unsigned unit = prog->next_unit++;
+            const unsigned pass = unit / n_tiles;
+            const unsigned begin = pass ? 1u << (pass - 1) : 0;
+            if(pass > 31 || begin >= params::N_samples) break;
+            const unsigned end = std::min(1u << pass, params::N_samples);
+
+            if(finished_before(unit)) continue;
+            if(!start_unit(unit)) break;
+            timed(end - begin, [&] {
+                for(unsigned s=begin; s < end; ++s)
+                    sample_tile();
+            });
+        }
+    }
+
+    void render_progressive() {
+        // Each unit adds PASS_SAMPLES to one tile; a pass is every tile once. No unit is
+        // started after the time budget runs out, so every pixel ends within one pass of the others.
+        const unsigned n_tiles = prog->tiles.size();
+        const unsigned max_passes = (params::MAX_SAMPLES + params::PASS_SAMPLES - 1) / params::PASS_SAMPLES;
+
+        while(!prog->stop) {
+            if(params::TIME_BUDGET && prog->elapsed() * 1000 >= float(params::TIME_BUDGET)) {
+                prog->stop = true;
+                break;
+            }
+
+            const unsigned unit = prog->next_unit++;
+            if(unit / n_tiles >= max_passes) break;
+            if(finished_before(unit)) continue;
+
+            // While the guiding field trains, a pass only starts once the previous one refined it
+            if(scn->guide) {
+                const unsigned needed = std::min(unit / n_tiles, scn->guide->passes());
+                while(scn->guide->iteration() < needed && !prog->stop)
+                    std::this_thread::yield();
+                if(prog->stop) break;
+            }
+
+            if(!start_unit(unit)) break;
+            timed(params::PASS_SAMPLES, [&] {
+                for(unsigned s=0; s < params::PASS_SAMPLES; ++s)
+                    sample_tile();
+            });
+
+            // Every pass over the frame, once all of its tiles have finished, refines the guiding
+            // field and checks the error target, in pass order. Whoever finds the next one done
+            // claims it; units of the next pass may finish before the last of this one.
+            unsigned seen = prog->passes_seen.load();
+            while(seen < prog->tiles.frame_passes()) {
+                if(!prog->passes_seen.compare_exchange_weak(seen, seen + 1)) continue;
+                if(scn->guide && scn->guide->training())
+                    scn->guide->refine();
+                if(params::TARGET_ERROR > 0 && frame_error() < params::TARGET_ERROR)
+                    prog->stop = true;
+                ++seen;
+            }
+        }
+    }
+
+    bool balance_tiles() {
+        // Cost pre-pass: every worker times blocks of the tiles it claims, the last to finish
+        // splits and reorders the tiles and everyone else waits for that. False if the render
+        // was stopped while waiting.
+        probe_costs(prog->cell_cost, prog->cell);
+        if(prog->probing.fetch_sub(1) == 1) {
+            prog->tiles.balance(prog->cell_cost, prog->cell, prog->balance_units);
+            prog->work_total = prog->tiles.total_cost() * prog->work_samples;
+            prog->start_clock();
+            prog->balanced.store(true, std::memory_order_release);
+            return true;
+        }
+        while(!prog->balanced.load(std::memory_order_acquire)) {
+            if(prog->stop) return false;
+            std::this_thread::yield();
+        }
+        return true;
     }
 
     void operator()() {
+        if(prog->probing.load() > 0 && !balance_tiles())
+            return;
+
+        if(params::PROGRESSIVE) {
+            render_progressive();
+            return;
+        }
+        if(params::INTERLEAVED && !params::ADAPTIVE) {
+            render_interleaved();
+            return;
+        }
+
         bool done = false;
         do {
-            if(!get_next_task()) {
+            if(prog->stop || !get_next_task()) {
                 done = true;
                 continue;
             }
 
-            for(unsigned s=0; s < params::N_samples; ++s) {
-                for(unsigned y=sy; y < sy + params::N; ++y) {
-                    for(unsigned x=sx; x < sx + params::N; ++x) {
-                        if(x < 0 || y < 0 || x >= params::WIDTH || y >= params::HEIGHT) continue;
-
-                        const auto u = (float)((x + random_float()) / (params::WIDTH));
-                        const auto v = (float)((y + random_float()) / (params::HEIGHT));
-                        ray r = cam->get_ray(u, v);
-                        const vec3 col = ray_color2(r, background, world, params::MAX_DEPTH);//ray_color2(r, background, world, params::MAX_DEPTH);
-                        const unsigned pos = (y * params::WIDTH + x) * 5;
-                        data[pos + 0] += col.x();
-                        data[pos + 1] += col.y();
-                        data[pos + 2] += col.z();
-                        data[pos + 3] += 255; // opaque
-                        data[pos + 4] += 1; // number of samples
-                    }
-                }
-            }
+            timed(params::N_samples, [this] {
+                if(params::ADAPTIVE)
+                    render_tile_adaptive();
+                else
+                    render_tile();
+            });
         } while(!done);
 
-        done_count++;
-
         std::cout << "Thread " << my_id << " is done!" << std::endl;
     }
 
+    unsigned tile{0};
     int sx = -1, sy = -1;
+    unsigned tw{0}, th{0}; // size of the current tile
     int my_id;
-    static int id;
-    hittable_list* world;
+    scene* scn;
     camera* cam;
-    float* data;
-    color background{};
+    framebuffer* fb;
+    tile_accumulator acc; // samples of the current tile not yet committed to fb
+    progress* prog;
 };
 
-int Task::id = 0;
-
 #endif //RAYTRACING_TASK_HPP
@@ -0,0 +1,122 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#ifndef RAYTRACING_THREAD_POOL_HPP
+#define RAYTRACING_THREAD_POOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+class thread_pool {
+    // Fixed set of worker threads that stay parked on a condition variable between jobs. Jobs
+    // run in submission order and get the index of the worker running them. on_start runs first
+    // on each new worker, for things like pinning it to a core.
+public:
+    explicit thread_pool(unsigned n = std::thread::hardware_concurrency(),
+                         const std::function<void(unsigned)>& on_start = {}) {
+        n = std::max(n, 1u);
+        for(unsigned i=0; i < n; ++i) {
+            workers.emplace_back([this, i, on_start] {
+                if(on_start) on_start(i);
+                work(i);
+            });
+        }
+    }
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    ~thread_pool() {
+        // Jobs already queued still run
+        {
+            std::lock_guard<std::mutex> lock{m};
+            stopping = true;
+        }
+        wake.notify_all();
+        for(auto& t : workers) t.join();
+    }
+
+    [[nodiscard]] unsigned size() const { return unsigned(workers.size()); }
+
+    // Queues f(worker); the future holds its result or exception
+    template<typename F>
+    auto submit(F&& f) -> std::future<std::invoke_result_t<F, unsigned>> {
+        using R = std::invoke_result_t<F, unsigned>;
+        auto task = std::make_shared<std::packaged_task<R(unsigned)>>(std::forward<F>(f));
+        auto result = task->get_future();
+        push([task](unsigned worker) { (*task)(worker); });
+        return result;
+    }
+
+    // Queues one copy of job per worker; the future is ready once every copy has returned and
+    // rethrows the first exception any of them threw
+    std::future<void> run_on_all(const std::function<void(unsigned)>& job) {
+        struct state {
+            std::atomic<unsigned> left;
+            std::promise<void> done;
+            std::mutex m;
+            std::exception_ptr error;
+        };
+        auto s = std::make_shared<state>();
+        s->left = size();
+        auto result = s->done.get_future();
+        for(unsigned i=0; i < size(); ++i) {
+            push([s, job](unsigned worker) {
+                try {
+                    job(worker);
+                }
+                catch(...) {
+                    std::lock_guard<std::mutex> lock{s->m};
+                    if(!s->error) s->error = std::current_exception();
+                }
+                if(--s->left == 0) {
+                    if(s->error) s->done.set_exception(s->error);
+                    else s->done.set_value();
+                }
+            });
+        }
+        return result;
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void(unsigned)>> jobs;
+    std::mutex m;
+    std::condition_variable wake;
+    bool stopping{false};
+
+    void push(std::function<void(unsigned)> job) {
+        {
+            std::lock_guard<std::mutex> lock{m};
+            jobs.push_back(std::move(job));
+        }
+        wake.notify_one();
+    }
+
+    void work(unsigned worker) {
+        while(true) {
+            std::function<void(unsigned)> job;
+            {
+                std::unique_lock<std::mutex> lock{m};
+                wake.wait(lock, [this] { return stopping || !jobs.empty(); });
+                if(jobs.empty()) return;
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+            job(worker);
+        }
+    }
+};
+
+#endif //RAYTRACING_THREAD_POOL_HPP
@@ -0,0 +1,132 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#ifndef RAYTRACING_TOPOLOGY_HPP
+#define RAYTRACING_TOPOLOGY_HPP
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+struct cpu_topology {
+    // CPUs grouped by NUMA node, read from sysfs on Linux. Elsewhere, or if sysfs has no nodes,
+    // everything is one node.
+    std::vector<std::vector<unsigned>> nodes;
+
+    static cpu_topology detect() {
+        cpu_topology t;
+#ifdef __linux__
+        for(unsigned n=0; ; ++n) {
+            std::ifstream in("/sys/devices/system/node/node" + std::to_string(n) + "/cpulist");
+            if(!in) break;
+            std::string list;
+            std::getline(in, list);
+            t.nodes.push_back(parse_list(list));
+        }
+#endif
+        if(t.nodes.empty()) {
+            t.nodes.emplace_back();
+            for(unsigned c=0; c < std::max(1u, std::thread::hardware_concurrency()); ++c)
+                t.nodes[0].push_back(c);
+        }
+        return t;
+    }
+
+    [[nodiscard]] unsigned cpus() const {
+        unsigned n = 0;
+        for(auto& node : nodes) n += unsigned(node.size());
+        return n;
+    }
+
+    // CPU for worker i: workers alternate between nodes so that every memory controller is in
+    // use whatever the thread count, then fill each node's CPUs in order
+    [[nodiscard]] unsigned cpu_for(unsigned worker) const {
+        if(cpus() == 0) return 0;
+        worker %= cpus();
+        std::vector<unsigned> used(nodes.size());
+        for(unsigned i=0; ; ++i) {
+            const unsigned n = i % nodes.size();
+            if(used[n] < nodes[n].size()) {
+                if(worker-- == 0) return nodes[n][used[n]];
+                ++used[n];
+            }
+        }
+    }
+
+    [[nodiscard]] std::string report() const {
+        std::ostringstream out;
+        out << nodes.size() << " NUMA node" << (nodes.size() == 1 ? "" : "s") << ", " << cpus() << " CPUs:";
+        for(unsigned n=0; n < nodes.size(); ++n)
+            out << " node " << n << " has " << nodes[n].size() << (n + 1 < nodes.size() ? "," : "");
+        return out.str();
+    }
+
+private:
+    static std::vector<unsigned> parse_list(const std::string& list) {
+        // "0-3,8,10-11"
+        std::vector<unsigned> cpus;
+        std::stringstream ss(list);
+        std::string range;
+        while(std::getline(ss, range, ',')) {
+            if(range.empty()) continue;
+            const auto dash = range.find('-');
+            const unsigned lo = std::stoul(range.substr(0, dash));
+            const unsigned hi = dash == std::string::npos ? lo : std::stoul(range.substr(dash + 1));
+            for(unsigned c=lo; c <= hi; ++c) cpus.push_back(c);
+        }
+        return cpus;
+    }
+};
+
+inline bool pin_current_thread(unsigned cpu) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
+
+class interleave_memory {
+    // While alive, pages the calling thread first touches are spread round-robin over all NUMA
+    // nodes instead of landing on the node it runs on. For data every worker reads, like the
+    // scene and the frame, when replicating it per node is not an option.
+public:
+    explicit interleave_memory(const cpu_topology& t, bool enable = true) {
+#if defined(__linux__) && defined(SYS_set_mempolicy)
+        if(!enable || t.nodes.size() < 2 || t.nodes.size() > 64) return;
+        const unsigned long mask = t.nodes.size() == 64 ? ~0ul : (1ul << t.nodes.size()) - 1;
+        active = syscall(SYS_set_mempolicy, mpol_interleave, &mask, t.nodes.size() + 1) == 0;
+#endif
+    }
+
+    interleave_memory(const interleave_memory&) = delete;
+    interleave_memory& operator=(const interleave_memory&) = delete;
+
+    ~interleave_memory() {
+#if defined(__linux__) && defined(SYS_set_mempolicy)
+        if(active) syscall(SYS_set_mempolicy, mpol_default, nullptr, 0);
+#endif
+    }
+
+    [[nodiscard]] bool enabled() const { return active; }
+
+private:
+    static constexpr int mpol_default = 0, mpol_interleave = 3; // from linux/mempolicy.h
+    bool active{false};
+};
+
+#endif //RAYTRACING_TOPOLOGY_HPP
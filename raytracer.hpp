@@ -5,10 +5,14 @@
 #ifndef RAYTRACING_RAYTRACER_HPP
 #define RAYTRACING_RAYTRACER_HPP
 
+#include <array>
+
 #include "rtweekend.hpp"
 #include "camera.hpp"
 
 #include "color.hpp"
+#include "scene.hpp"
+#include "sampling/reservoir.hpp"
 #include "hittable/hittable_list.hpp"
 #include "modifiers/material.hpp"
 
@@ -38,31 +42,482 @@ color ray_color(const ray& r, const color& background, const hittable_list* worl
         * ray_color(scattered, background, world, depth-1) / srec.pdf;
 }
 
-color ray_color2(const ray& r, const color& background, const hittable_list* world, int depth) {
+inline float power_heuristic(float pdf_a, float pdf_b) {
+    const float a2 = pdf_a * pdf_a;
+    return a2 / (a2 + pdf_b * pdf_b);
+}
+
+inline float media_transmittance(const scene& scn, const ray& r, float t_max) {
+    float tr = 1;
+    for(const auto& m : scn.media) {
+        tr *= m->transmittance(r, 0.001f, t_max);
+        if(tr <= 0) break;
+    }
+    return tr;
+}
+
+inline float visibility(const scene& scn, const ray& shadow, float t_max) {
+    // 0 if a surface blocks the shadow ray, otherwise the transmittance through the media
+    hit_record rec;
+    if(scn.world.hit(shadow, 0.001f, t_max, rec))
+        return 0;
+    return media_transmittance(scn, shadow, t_max);
+}
+
+const medium* sample_media(const scene& scn, const ray& r, float t_max, float& t) {
+    // Media collide independently, so the first collision of all of them is the nearest one
+    const medium* hit_medium = nullptr;
+    for(const auto& m : scn.media) {
+        float tm;
+        if(m->sample_distance(r, 0.001f, t_max, tm)) {
+            t_max = t = tm;
+            hit_medium = m.get();
+        }
+    }
+    return hit_medium;
+}
+
+inline bool guided(const scene& scn, const hit_record& rec) {
+    // Guiding is used at surface vertices once the field has finished a training pass
+    return scn.guide && scn.guide->ready() && rec.normal.length_squared() > 0;
+}
+
+inline float continuation_pdf(const scene& scn, const ray& r_in, const hit_record& rec, const ray& scattered) {
+    // pdf of the direction the path continues in: the BSDF's, or its one-sample mixture with the guiding field
+    const float bsdf_pdf = rec.mat_ptr->scattering_pdf(r_in, rec, scattered);
+    if(!guided(scn, rec))
+        return bsdf_pdf;
+    const float f = guiding_field::guide_fraction;
+    return f * scn.guide->pdf(rec.p, scattered.direction()) + (1 - f) * bsdf_pdf;
+}
+
+struct medium_segment {
+    // The stretch [t0, t1] of a ray inside one medium. Equi-angular sampling picks t along it with
+    // density proportional to 1/distance^2 to a light point x, which distance sampling cannot do.
+    const medium* m{};
+    ray r;
+    float t0{0}, t1{0};
+
+    [[nodiscard]] point3 midpoint() const { return r.at(.5f * (t0 + t1)); }
+
+    [[nodiscard]] float sample(const point3& x, float u, float& pdf) const {
+        float delta, d, theta_a, theta_b;
+        if(!frame(x, delta, d, theta_a, theta_b)) {
+            pdf = 0;
+            return t0;
+        }
+        const float len = r.direction().length();
+        const float t = fclamp((delta + d * tanf(theta_a + u * (theta_b - theta_a))) / len, t0, t1);
+        const float s = t * len - delta;
+        pdf = len * d / ((theta_b - theta_a) * (d*d + s*s));
+        return t;
+    }
+
+    [[nodiscard]] float pdf(const point3& x, float t) const {
+        float delta, d, theta_a, theta_b;
+        if(t < t0 || t > t1 || !frame(x, delta, d, theta_a, theta_b))
+            return 0;
+        const float s = t * r.direction().length() - delta;
+        return r.direction().length() * d / ((theta_b - theta_a) * (d*d + s*s));
+    }
+
+private:
+    bool frame(const point3& x, float& delta, float& d, float& theta_a, float& theta_b) const {
+        // delta: distance along the ray to the point closest to x, d: distance from x to the ray
+        const float len = r.direction().length();
+        const vec3 dir = r.direction() / len;
+        delta = dot(x - r.origin(), dir);
+        d = fmax((x - r.origin() - delta * dir).length(), 1e-4f);
+        theta_a = atanf((t0 * len - delta) / d);
+        theta_b = atanf((t1 * len - delta) / d);
+        return theta_b > theta_a;
+    }
+};
+
+float light_area_pdf(const scene& scn, int l, const point3& from, const point3& x) {
+    // Density per unit area with which picking and sampling light l from `from` yields x; 0 if x
+    // is not the first point of the light seen from there
+    const hittable* light = scn.lights.light(l).obj;
+    const ray to(from, x - from);
+    hit_record lrec;
+    if(!light->hit(to, 0.001f, f_infinity, lrec) || lrec.t < .999f)
+        return 0;
+    const float cos_x = fabs(dot(lrec.normal, unit_vector(to.direction())));
+    return scn.lights.pmf(from, vec3(0,0,0), l) * light->pdf_value(from, to.direction())
+           * cos_x / to.direction().length_squared();
+}
+
+struct medium_vertex {
+    // A distance-sampled collision at seg.r.at(t), kept so that light reached from it can be
+    // weighted against equi-angular sampling of the same segment. pdf is the distance sampling
+    // density of t.
+    medium_segment seg;
+    float t{0};
+    float pdf{0};
+
+    // Solid angle pdf at the collision of reaching x on light l by equi-angular sampling, with
+    // the distance sampling pdf divided out. cos_x is the cosine at x toward the collision.
+    [[nodiscard]] float equiangular_pdf(const scene& scn, int l, const point3& x, float cos_x) const {
+        if(!seg.m || pdf <= 0 || cos_x <= 0)
+            return 0;
+        const float pe = seg.pdf(x, t);
+        if(pe <= 0)
+            return 0;
+        return pe / pdf * light_area_pdf(scn, l, seg.midpoint(), x)
+               * (x - seg.r.at(t)).length_squared() / cos_x;
+    }
+};
+
+color sample_equiangular(const scene& scn, const medium_segment& seg) {
+    // Single scattering along seg toward a light point, with t drawn equi-angularly. MIS-weighted
+    // against distance sampling followed by either light or phase function sampling.
+    const point3 mid = seg.midpoint();
+    float pmf;
+    const int l = scn.lights.sample(mid, vec3(0,0,0), random_float(), pmf);
+    if(l < 0)
+        return color(0,0,0);
+
+    const hittable* light = scn.lights.light(l).obj;
+    hit_record lrec;
+    if(!light->hit(ray(mid, light->random(mid), seg.r.time()), 0.001f, f_infinity, lrec))
+        return color(0,0,0);
+    const point3 x = lrec.p;
+
+    float pe;
+    const float t = seg.sample(x, random_float(), pe);
+    const float area_pdf = light_area_pdf(scn, l, mid, x);
+    if(pe <= 0 || area_pdf <= 0)
+        return color(0,0,0);
+
+    // Light leaving x toward the scattering point
+    const point3 p = seg.r.at(t);
+    const ray shadow(p, x - p, seg.r.time());
+    hit_record erec;
+    if(!light->hit(shadow, 0.001f, f_infinity, erec) || erec.t < .999f)
+        return color(0,0,0);
+    const color emitted = erec.mat_ptr->emitted(shadow, erec, erec.u, erec.v, erec.p);
+    if(emitted.x() <= 0 && emitted.y() <= 0 && emitted.z() <= 0)
+        return color(0,0,0);
+
+    const vec3 wi = unit_vector(shadow.direction());
+    const float dist2 = shadow.direction().length_squared();
+    const float g = fabs(dot(erec.normal, wi)) / dist2;
+    const float vis = visibility(scn, shadow, .999f);
+    if(g <= 0 || vis <= 0)
+        return color(0,0,0);
+
+    // Distance sampling pdf of a collision in this medium at t, and the area pdfs of the three strategies
+    const float sigma = seg.m->extinction(p) * seg.r.direction().length();
+    const float tr = media_transmittance(scn, seg.r, t);
+    const float phase = 1 / (4*fpi);
+    const float p_equiangular = pe * area_pdf;
+    const float p_light = sigma * tr * scn.lights.pmf(p, vec3(0,0,0), l) * light->pdf_value(p, wi) * g;
+    const float p_phase = sigma * tr * phase * g;
+    const float w = p_equiangular * p_equiangular
+                    / (p_equiangular * p_equiangular + p_light * p_light + p_phase * p_phase);
+
+    return w * tr * sigma * seg.m->albedo * phase * emitted * vis * g / p_equiangular;
+}
+
+color sample_environment(const scene& scn, const ray& r_in, const hit_record& rec, const scatter_record& srec) {
+    // Next event estimation toward the environment, MIS-weighted against the BSDF sample
+    float light_pdf;
+    const vec3 dir = scn.env->sample(light_pdf);
+    if(light_pdf <= 0)
+        return color(0,0,0);
+
+    const ray shadow(rec.p, dir, r_in.time());
+    const float bsdf = rec.mat_ptr->scattering_pdf(r_in, rec, shadow);
+    if(bsdf <= 0)
+        return color(0,0,0);
+    const float bsdf_pdf = continuation_pdf(scn, r_in, rec, shadow);
+    const float vis = visibility(scn, shadow, f_infinity);
+    if(vis <= 0)
+        return color(0,0,0);
+
+    // attenuation * scattering_pdf is the BSDF times the cosine term
+    return vis * srec.attenuation * bsdf * scn.env->value(dir) * power_heuristic(light_pdf, bsdf_pdf) / light_pdf;
+}
+
+color sample_lights(const scene& scn, const ray& r_in, const hit_record& rec, const scatter_record& srec,
+                    const medium_vertex* mv = nullptr) {
+    // Next event estimation toward one emitter picked by the light tree, MIS-weighted against
+    // BSDF samples that hit the same emitter, and against equi-angular sampling at medium vertices
+    float pmf;
+    const int l = scn.lights.sample(rec.p, rec.normal, random_float(), pmf);
+    if(l < 0)
+        return color(0,0,0);
+
+    const hittable* light = scn.lights.light(l).obj;
+    const ray shadow(rec.p, unit_vector(light->random(rec.p)), r_in.time());
+    hit_record lrec;
+    if(!light->hit(shadow, 0.001f, f_infinity, lrec))
+        return color(0,0,0);
+
+    const float light_pdf = pmf * light->pdf_value(rec.p, shadow.direction());
+    const float bsdf = rec.mat_ptr->scattering_pdf(r_in, rec, shadow);
+    if(light_pdf <= 0 || bsdf <= 0)
+        return color(0,0,0);
+    const float bsdf_pdf = continuation_pdf(scn, r_in, rec, shadow);
+    const float vis = visibility(scn, shadow, lrec.t * .999f);
+    if(vis <= 0)
+        return color(0,0,0);
+
+    const color emitted = lrec.mat_ptr->emitted(shadow, lrec, lrec.u, lrec.v, lrec.p);
+    float w = power_heuristic(light_pdf, bsdf_pdf);
+    if(mv) {
+        const float cos_x = fabs(dot(lrec.normal, shadow.direction()));
+        const float pe = mv->equiangular_pdf(scn, l, lrec.p, cos_x);
+        w = light_pdf * light_pdf / (light_pdf * light_pdf + bsdf_pdf * bsdf_pdf + pe * pe);
+    }
+    return vis * srec.attenuation * bsdf * emitted * w / light_pdf;
+}
+
+float light_target(const ray& r_in, const hit_record& rec, const color& albedo, const light_candidate& c,
+                   color* contribution = nullptr) {
+    // Unshadowed contribution of c at rec per unit light area; its luminance is the resampling
+    // target. albedo is the attenuation from scattering at rec.
+    const vec3 d = c.x - rec.p;
+    const float dist2 = d.length_squared();
+    const vec3 wi = unit_vector(d);
+    const float cos_l = -dot(c.n, wi);
+    if(c.light < 0 || dist2 <= 0 || cos_l <= 0)
+        return 0;
+    const float bsdf = rec.mat_ptr->scattering_pdf(r_in, rec, ray(rec.p, wi, r_in.time()));
+    if(bsdf <= 0)
+        return 0;
+
+    const color f = albedo * bsdf * c.le * cos_l / dist2;
+    if(contribution) *contribution = f;
+    return luminance(f);
+}
+
+reservoir light_candidates(const scene& scn, const ray& r_in, const hit_record& rec, const color& albedo, int n) {
+    // Resampled importance sampling: n cheap, unshadowed light samples streamed through a reservoir
+    reservoir res;
+    for(int i=0; i < n; ++i) {
+        float pmf;
+        const int l = scn.lights.sample(rec.p, rec.normal, random_float(), pmf);
+        if(l < 0) {
+            res.update({}, 0);
+            continue;
+        }
+        const hittable* light = scn.lights.light(l).obj;
+        const ray to_light(rec.p, light->random(rec.p), r_in.time());
+        hit_record lrec;
+        if(!light->hit(to_light, 0.001f, f_infinity, lrec)) {
+            res.update({}, 0);
+            continue;
+        }
+
+        light_candidate c{l, lrec.p, lrec.front_face ? lrec.normal : -lrec.normal,
+                          lrec.mat_ptr->emitted(to_light, lrec, lrec.u, lrec.v, lrec.p)};
+        // Light sampling pdf converted from solid angle to area
+        const vec3 d = lrec.p - rec.p;
+        const float cos_l = fabs(dot(lrec.normal, unit_vector(d)));
+        const float pdf = pmf * light->pdf_value(rec.p, d) * cos_l / d.length_squared();
+        res.update(c, pdf > 0 ? light_target(r_in, rec, albedo, c) / pdf : 0);
+    }
+    res.finalize(light_target(r_in, rec, albedo, res.y));
+    return res;
+}
+
+color shade_reservoir(const scene& scn, const ray& r_in, const hit_record& rec, const color& albedo, const reservoir& res) {
+    // The one shadow ray of a reservoir, toward its selected sample
+    color f;
+    if(res.W <= 0 || light_target(r_in, rec, albedo, res.y, &f) <= 0)
+        return color(0,0,0);
+    const ray shadow(rec.p, res.y.x - rec.p, r_in.time());
+    return visibility(scn, shadow, .999f) * f * res.W;
+}
+
+struct shading_point {
+    // A primary hit that reservoirs are resampled at
+    ray r;
+    hit_record rec;
+    color albedo;
+    bool valid{false};
+
+    [[nodiscard]] float target(const light_candidate& c) const { return light_target(r, rec, albedo, c); }
+};
+
+reservoir combine_reservoirs(const shading_point* const pts[], const reservoir* const rs[], int n) {
+    // Resamples n reservoirs, each drawn at its own shading point, for pts[0]. The weights are the
+    // generalized balance heuristic over every point's unshadowed target: unbiased, and bounded
+    // even when a sample matters far more at pts[0] than where it was drawn, which the plain
+    // 1/M weighting is not.
+    reservoir out;
+    for(int k=0; k < n; ++k) {
+        const reservoir& r = *rs[k];
+        float own = 0, all = 0;
+        for(int l=0; l < n && r.W > 0; ++l) {
+            const float t = rs[l]->M * pts[l]->target(r.y);
+            all += t;
+            if(l == k) own = t;
+        }
+        out.update(r.y, all > 0 ? own / all * pts[0]->target(r.y) * r.W : 0, r.M);
+    }
+    out.finalize_mis(pts[0]->target(out.y));
+    return out;
+}
+
+color ray_color2(const ray& r, const scene& scn, int depth, int rr_depth = 3, bool primary_lights = true) {
+    // depth is the hard bounce cap; from rr_depth on, paths are terminated by Russian roulette.
+    // primary_lights is false when the caller handles the direct light from emitters at the first
+    // diffuse surface hit itself, as reservoir resampling does.
     ray r_in = r;
-    color rcolor = color(1,1,1);
-    while(true) {
+    color radiance = color(0,0,0);
+    color rcolor = color(1,1,1); // path throughput
+    float bsdf_pdf = 0; // pdf of the last bounce, 0 if it was specular
+    point3 prev_p;      // last non-specular vertex, for MIS on emitters hit by the BSDF sample
+    vec3 prev_n;
+    medium_vertex prev_mv; // set when that vertex was a medium collision
+    // Equi-angular sampling needs exact distance sampling pdfs for its MIS weights
+    const bool equiangular = !scn.media.empty() && !scn.lights.empty() && scn.analytic_media();
+
+    // Diffuse surface vertices, whose radiance estimates feed the guiding field and the
+    // radiance cache once the path ends. The _in values are taken on arrival, after emission;
+    // the _out values after next event estimation and the bounce. pdf stays 0 without a bounce.
+    struct path_vertex {
+        point3 p;
+        vec3 n;
+        color throughput_in, radiance_in;
+        vec3 dir;
+        float pdf;
+        color throughput_out, radiance_out;
+    };
+    constexpr int max_vertices = 32;
+    const bool training = scn.guide && scn.guide->training();
+    path_vertex* vertices = nullptr;
+    int n_vertices = 0;
+    if(training || scn.cache) {
+        // Reused by every path on the thread, so that paths recording nothing don't build it
+        thread_local std::array<path_vertex, max_vertices> scratch;
+        vertices = scratch.data();
+    }
+    bool skip_emitters = false; // the last vertex left its emitter lighting to the caller
+    for(int bounce = 0; bounce < depth; ++bounce) {
         hit_record rec;
-        if(depth <= 0)
-            return color(0,0,0);
-        if(!world->hit(r_in, 0.001f, f_infinity, rec))
-            return background * rcolor;
+        const bool hit_surface = scn.world.hit(r_in, 0.001f, f_infinity, rec);
+        const float t_surface = hit_surface ? rec.t : f_infinity;
+        if(equiangular) {
+            for(const auto& m : scn.media) {
+                medium_segment seg{m.get(), r_in};
+                if(luminance(m->albedo) > 0 && m->interval(r_in, 0.001f, t_surface, seg.t0, seg.t1))
+                    radiance += rcolor * sample_equiangular(scn, seg);
+            }
+        }
+        medium_vertex mv;
+        float t_medium;
+        if(const medium* m = sample_media(scn, r_in, t_surface, t_medium)) {
+            // Scattering inside a medium: the phase function takes over from the surface
+            if(equiangular) {
+                mv.seg = {m, r_in};
+                m->interval(r_in, 0.001f, t_surface, mv.seg.t0, mv.seg.t1);
+                mv.t = t_medium;
+                mv.pdf = m->extinction(r_in.at(t_medium)) * r_in.direction().length()
+                         * media_transmittance(scn, r_in, t_medium);
+            }
+            rec.t = t_medium;
+            rec.p = r_in.at(t_medium);
+            rec.normal = vec3(0,0,0);
+            rec.u = rec.v = 0;
+            rec.front_face = true;
+            rec.mat_ptr = m->phase_function;
+            rec.obj = nullptr;
+        }
+        else if(!hit_surface) {
+            const float w = scn.env && bsdf_pdf > 0
+                    ? power_heuristic(bsdf_pdf, scn.env->pdf(r_in.direction())) : 1.0f;
+            radiance += w * scn.miss(r_in) * rcolor;
+            break;
+        }
         scatter_record srec;
-        color emitted = rec.mat_ptr->emitted(r, rec, rec.u, rec.v, rec.p);
+        color emitted = rec.mat_ptr->emitted(r_in, rec, rec.u, rec.v, rec.p);
+        if(bsdf_pdf > 0 && (emitted.x() > 0 || emitted.y() > 0 || emitted.z() > 0)) {
+            const int l = scn.lights.index_of(rec.obj);
+            if(l >= 0 && skip_emitters) {
+                emitted = color(0,0,0);
+            }
+            else if(l >= 0) {
+                const float light_pdf = scn.lights.pmf(prev_p, prev_n, l) * rec.obj->pdf_value(prev_p, r_in.direction());
+                const float cos_x = fabs(dot(rec.normal, unit_vector(r_in.direction())));
+                const float pe = prev_mv.equiangular_pdf(scn, l, rec.p, cos_x);
+                emitted *= bsdf_pdf * bsdf_pdf / (bsdf_pdf * bsdf_pdf + light_pdf * light_pdf + pe * pe);
+            }
+        }
+        radiance += emitted * rcolor;
         if(!rec.mat_ptr->scatter(r_in, rec, srec))
-            return emitted * rcolor;
+            break;
 
         if(srec.is_specular) {
-            r_in = srec.specular_ray;
             rcolor = srec.attenuation * rcolor;
-            --depth;
-            continue;
+            bsdf_pdf = 0;
         }
+        else {
+            const bool surface = rec.normal.length_squared() > 0;
+            // Deep enough into the path, a filled cache cell stands in for everything beyond here
+            color cached;
+            if(surface && scn.cache && bounce >= (int)scn.cache->depth() && scn.cache->lookup(rec.p, rec.normal, cached)) {
+                radiance += rcolor * cached;
+                break;
+            }
+            // A vertex whose direct light the caller adds would record its radiance without it
+            skip_emitters = bounce == 0 && surface && !primary_lights;
+            path_vertex* v = nullptr;
+            if(surface && !skip_emitters && vertices && n_vertices < max_vertices) {
+                v = &vertices[n_vertices++];
+                *v = {rec.p, rec.normal, rcolor, radiance, vec3(0,0,0), 0, color(0,0,0), color(0,0,0)};
+            }
 
+            if(scn.env)
+                radiance += rcolor * sample_environment(scn, r_in, rec, srec);
+            if(!scn.lights.empty() && !skip_emitters)
+                radiance += rcolor * sample_lights(scn, r_in, rec, srec, mv.seg.m ? &mv : nullptr);
+            if(guided(scn, rec) && random_float() < guiding_field::guide_fraction)
+                srec.specular_ray = ray(rec.p, scn.guide->sample(rec.p), r_in.time());
+            const float bsdf = rec.mat_ptr->scattering_pdf(r_in, rec, srec.specular_ray);
+            bsdf_pdf = guided(scn, rec) ? continuation_pdf(scn, r_in, rec, srec.specular_ray) : srec.pdf;
+            if(bsdf <= 0 || bsdf_pdf <= 0)
+                break;
+            rcolor = srec.attenuation * bsdf * rcolor / bsdf_pdf;
+            if(v) {
+                v->dir = srec.specular_ray.direction();
+                v->pdf = bsdf_pdf;
+                v->throughput_out = rcolor;
+                v->radiance_out = radiance;
+            }
+            prev_p = rec.p;
+            prev_n = rec.normal;
+            prev_mv = mv;
+        }
         r_in = srec.specular_ray;
-        --depth;
-        rcolor = emitted + srec.attenuation * rec.mat_ptr->scattering_pdf(r_in, rec, srec.specular_ray) * rcolor / srec.pdf;
+        // Russian roulette: survive with probability q taken from the throughput and
+        // divide the survivors by q, so dark paths stop early without biasing the estimate.
+        if(bounce + 1 >= rr_depth) {
+            const float q = fmin(fmax(rcolor.x(), fmax(rcolor.y(), rcolor.z())), .95f);
+            if(random_float() >= q)
+                break;
+            rcolor /= q;
+        }
+    }
+
+    // Whatever the path gathered after a point, over the throughput up to it, estimates the
+    // radiance there: arriving from the sampled direction for guiding, leaving the surface for the cache
+    auto ratio = [](const color& a, const color& b) {
+        color out(0,0,0);
+        for(int c=0; c < 3; ++c)
+            if(b[c] > 0) out[c] = a[c] / b[c];
+        return out;
+    };
+    for(int i=0; i < n_vertices; ++i) {
+        const path_vertex& v = vertices[i];
+        if(training && v.pdf > 0)
+            scn.guide->record(v.p, v.dir, luminance(ratio(radiance - v.radiance_out, v.throughput_out)) / v.pdf);
+        if(scn.cache)
+            scn.cache->record(v.p, v.n, ratio(radiance - v.radiance_in, v.throughput_in));
     }
+    return radiance;
 }
 
 color first_hit(const ray& r, const color& background, const hittable_list* world, int depth) {
@@ -9,11 +9,37 @@
 
 #include "denoise.hpp"
 #include "timer.hpp"
+#include "parallel/image_output.hpp"
 #include "parallel/pixels.hpp"
+#include "parallel/renderer.hpp"
 #include "parallel/task.hpp"
 #include "parallel/params.hpp"
+#include "scene_select.hpp"
+
+void report_spp(const frame_planes& data) {
+    float min_ns = f_infinity, max_ns = 0, sum = 0;
+    for(unsigned y=0; y < data.height(); ++y) {
+        for(unsigned x=0; x < data.width(); ++x) {
+            const float ns = data.samples(x, y);
+            min_ns = fmin(min_ns, ns);
+            max_ns = fmax(max_ns, ns);
+            sum += ns;
+        }
+    }
+    std::cout << "Samples per pixel: min " << min_ns << ", avg " << sum / float(data.width() * data.height())
+              << ", max " << max_ns << std::endl;
+}
 
-void render_window(point3& lookfrom, point3& lookat, float vfov, float aperture, hittable_list& world, color& background) {
+bool load_font(sf::Font& font) {
+    // First of a few common places that has one
+    for(const char* path : {"resources/arial.ttf", "/Library/Fonts/Arial.ttf", "/System/Library/Fonts/Supplemental/Arial.ttf",
+                            "/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf", "C:/Windows/Fonts/arial.ttf"})
+        if(font.loadFromFile(path)) return true;
+    std::cerr << "No font found; the window shows no text" << std::endl;
+    return false;
+}
+
+void render_window(renderer& rend, scene_setup& setup) {
     // Render window
 
     sf::RenderWindow window(sf::VideoMode(params::WIDTH, (params::WIDTH/params::ASPECT_RATIO)),
@@ -33,7 +59,9 @@ void render_window(point3& lookfrom, point3& lookat, float vfov, float aperture,
     sprite.setTexture(tex);
 
     pixels pix = pixels(params::WIDTH, params::HEIGHT);
-    std::vector<float> data(params::WIDTH * params::HEIGHT * 5);
+    frame_planes data; // copy of the job's frame, for display, updated tile by tile while it renders
+    std::vector<unsigned> shown; // passes of each tile in data
+    std::vector<uint8_t> tile_pix;
 
     int wind_w = 700;
     int wind_h = 700/params::ASPECT_RATIO;
@@ -44,9 +72,9 @@ void render_window(point3& lookfrom, point3& lookat, float vfov, float aperture,
     popup.setOutlineThickness(7);
     popup.setOutlineColor(sf::Color(120, 120, 120));
 
-    sf::Font title;
-    title.loadFromFile("/Users/andrewyang/CLionProjects/untitled/arial.ttf");
-    sf::Text textt("Title", title);
+    sf::Font font;
+    load_font(font);
+    sf::Text textt("Title", font);
     textt.setFillColor(sf::Color::Black);
     textt.setCharacterSize(wind_w / 43.333f);
     sf::FloatRect textTitle = textt.getLocalBounds();
@@ -58,9 +86,7 @@ void render_window(point3& lookfrom, point3& lookat, float vfov, float aperture,
     buttonl.setFillColor(sf::Color::Blue);
     buttonl.move((float)wind_w/2 - wind_w/4.4, (float)wind_h/1.75f);
 
-    sf::Font fontl;
-    fontl.loadFromFile("/Users/andrewyang/CLionProjects/untitled/arial.ttf");
-    sf::Text textl("No", fontl);
+    sf::Text textl("No", font);
     textl.setFillColor(sf::Color::White);
     textl.setCharacterSize(wind_w / 43.333f);
     sf::FloatRect textRectl = textl.getLocalBounds();
@@ -72,9 +98,7 @@ void render_window(point3& lookfrom, point3& lookat, float vfov, float aperture,
     buttonr.setFillColor(sf::Color::Blue);
     buttonr.move((float)wind_w/2 + (float)wind_w/9, (float)wind_h/1.75f);
 
-    sf::Font fontr;
-    fontr.loadFromFile("/Users/andrewyang/CLionProjects/untitled/arial.ttf");
-    sf::Text textr("Yes", fontr);
+    sf::Text textr("Yes", font);
     textr.setFillColor(sf::Color::White);
     textr.setCharacterSize(wind_w / 43.333f);
     sf::FloatRect textRectr = textl.getLocalBounds();
@@ -85,19 +109,17 @@ void render_window(point3& lookfrom, point3& lookat, float vfov, float aperture,
     bool clicked = false;
     bool hide = false;
 
-    // Camera
-
-    vec3 vup(0, 1, 0);
-    auto dist_to_focus = 10.0f;
-    camera cam(lookfrom, lookat, vup, vfov, params::ASPECT_RATIO, aperture, dist_to_focus, .0f, 1.0f);
+    scene& scn = setup.scn;
+    const camera cam = setup.make_camera();
 
-    const unsigned int n_threads = std::thread::hardware_concurrency();
-    std::cout << "Detected " << n_threads << " concurrent threads." << std::endl;
-    std::vector<std::thread> threads(n_threads);
+    std::cout << "Rendering on " << rend.threads() << " threads." << std::endl;
 
     Timer timer;
+    std::shared_ptr<render_job> job = rend.submit(scn, cam);
 
-    for(auto& t : threads) t = std::thread(Task{&world, &cam, background, &data[0]});
+    std::cout << "Sampling " << scn.lights.size() << " lights." << std::endl;
+    if(params::GUIDING && !params::PROGRESSIVE)
+        std::cout << "Path guiding trains over progressive passes; set PROGRESSIVE to use it." << std::endl;
 
     bool finished_rendering = false;
 
@@ -128,8 +150,8 @@ void render_window(point3& lookfrom, point3& lookat, float vfov, float aperture,
                         window.create(sf::VideoMode(params::WIDTH, (params::WIDTH/params::ASPECT_RATIO)),
                                       "Ray Tracing", sf::Style::Titlebar | sf::Style::Close);
                         window.setSize(sf::Vector2u(700, 700/params::ASPECT_RATIO));
-                        data_denoise(data);
-                        tex.update(&pix.get_pixels(data)[0]);
+                        if(data_denoise(data))
+                            tex.update(&pix.get_pixels(data)[0]);
                         clicked = true;
                         hide = false;
                     }
@@ -139,8 +161,16 @@ void render_window(point3& lookfrom, point3& lookat, float vfov, float aperture,
             }
         }
 
-        if(!finished_rendering)
-            tex.update(&pix.get_pixels(data)[0]);
+        if(!finished_rendering) {
+            // Only the tiles that changed are converted and uploaded
+            job->refresh(data, shown, [&](const tile_rect& t) {
+                pix.get_tile_pixels(data, t, tile_pix);
+                tex.update(tile_pix.data(), t.w, t.h, t.x, params::HEIGHT - t.y - t.h);
+            });
+            const float eta = job->eta_seconds();
+            if(!hide && eta >= 0)
+                window.setTitle("Ray Tracing - about " + std::to_string(int(eta + .5f)) + " s left");
+        }
 
         window.clear();
         if(!hide)
@@ -155,22 +185,47 @@ void render_window(point3& lookfrom, point3& lookat, float vfov, float aperture,
         }
         window.display();
 
-        if(!finished_rendering && done_count == n_threads) {
+        if(!finished_rendering && job->finished()) {
+            job->snapshot(data);
+            tex.update(&pix.get_pixels(data)[0]);
             textt.setString("        Finished rendering in:\n" + timer.to_string() + "  Apply OpenImageDenoise?");
             window.create(sf::VideoMode(wind_w, wind_h),
                           "Ray Tracing", sf::Style::Titlebar | sf::Style::Close);
             hide = true;
             finished_rendering = true;
+            report_spp(data);
         }
 
         sf::sleep(sf::milliseconds(200));
     }
 
-    std::cout << "Waiting for all threads to join" << std::endl;
-    for(auto& t : threads) t.join();
-
-    tex.copyToImage().saveToFile("output/out.png");
-    std::cout << "Saved image to out.png" << std::endl;
+    if(!finished_rendering) {
+        std::cout << "Cancelling the render" << std::endl;
+        job->cancel();
+        job->get();
+        job->snapshot(data);
+        tex.update(&pix.get_pixels(data)[0]);
+    }
+    job->get();
+
+    // Written from the frame rather than read back from the texture, while the maps are made
+    image_writer writer;
+    auto saved = writer.write("output/out.png", pix.get_pixels(data), params::WIDTH, params::HEIGHT);
+    auto saved_linear = writer.write("output/out.exr", data);
+
+    std::future<bool> saved_spp;
+    if(params::ADAPTIVE || params::PROGRESSIVE)
+        saved_spp = writer.write("output/samples.png", pix.get_sample_map(data), params::WIDTH, params::HEIGHT);
+    auto saved_cost = writer.write("output/tile_cost.png", pix.get_tile_cost_map(job->tiles()), params::WIDTH, params::HEIGHT);
+
+    auto report = [](std::future<bool>& done, const char* what) {
+        if(done.get()) std::cout << "Saved " << what << std::endl;
+        else std::cerr << "Couldn't write " << what << std::endl;
+    };
+    report(saved, "image to out.png");
+    report(saved_linear, "linear image to out.exr");
+    if(saved_spp.valid()) report(saved_spp, "samples per pixel map to samples.png");
+    report(saved_cost, "render time per tile to tile_cost.png");
     return;
 }
 
@@ -6,6 +6,7 @@
 #define RAYTRACING_RTWEEKEND_HPP
 
 #include <cmath>
+#include <cstdint>
 #include <limits>
 #include <memory>
 #include <cstdlib>
@@ -30,12 +31,32 @@ inline float degrees_to_radians(float degrees) {
     return degrees * fpi / 180.0;
 }
 
+inline std::minstd_rand& random_generator() {
+    // One per thread, shared by random_double and random_float
+    thread_local std::minstd_rand generator(std::random_device{}());
+    return generator;
+}
+
+inline void seed_random(unsigned seed) {
+    // Makes the calling thread's following random numbers repeatable, e.g. to build the same
+    // random scene in several processes
+    random_generator().seed(seed);
+}
+
+inline void seed_random(uint64_t seed, uint64_t stream) {
+    // Independent repeatable sequence number stream of seed, such as one per unit of work.
+    // The two are mixed with splitmix64 so that neighbouring streams do not start alike.
+    uint64_t z = seed + (stream + 1) * 0x9e3779b97f4a7c15ull;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    z ^= z >> 31;
+    random_generator().seed(unsigned(z % 2147483646u) + 1);
+}
+
 inline double random_double() {
     // Returns a random real between [0, 1)
     static std::uniform_real_distribution<double> distribution(.0, 1.0);
-    std::random_device dev;
-    static std::minstd_rand generator(dev());
-    return distribution(generator);
+    return distribution(random_generator());
 }
 
 inline double random_double(double min, double max) {
@@ -46,9 +67,7 @@ inline double random_double(double min, double max) {
 inline float random_float() {
     // Returns a random float real between [0, 1)
     static std::uniform_real_distribution<float> distribution(.0, 1.0);
-    std::random_device dev;
-    static std::minstd_rand generator(dev());
-    return distribution(generator);
+    return distribution(random_generator());
 }
 
 inline float random_float(float min, float max) {
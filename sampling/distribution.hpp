@@ -0,0 +1,96 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#ifndef RAYTRACING_DISTRIBUTION_HPP
+#define RAYTRACING_DISTRIBUTION_HPP
+
+#include <algorithm>
+#include <vector>
+
+#include "rtweekend.hpp"
+
+class alias_table {
+    // Walker/Vose alias table: O(1) sampling of a discrete distribution from one uniform number.
+public:
+    alias_table() = default;
+    explicit alias_table(const std::vector<float>& weights);
+
+    [[nodiscard]] int sample(float u) const {
+        const float scaled = u * (float)prob.size();
+        const int i = std::min(int(scaled), int(prob.size()) - 1);
+        return scaled - (float)i < prob[i] ? i : alias[i];
+    }
+
+    [[nodiscard]] float pmf(int i) const { return p[i]; }
+    [[nodiscard]] float total() const { return sum; }
+    [[nodiscard]] int size() const { return int(p.size()); }
+
+private:
+    std::vector<float> prob;  // probability of keeping bucket i
+    std::vector<int> alias;   // bucket to fall back to
+    std::vector<float> p;     // normalized probability of every entry
+    float sum{};
+};
+
+alias_table::alias_table(const std::vector<float>& weights)
+        : prob(weights.size()), alias(weights.size()), p(weights.size()) {
+    const int n = int(weights.size());
+    for(float w : weights) sum += w;
+
+    // An all-zero distribution falls back to uniform
+    for(int i=0; i < n; ++i) p[i] = sum > 0 ? weights[i] / sum : 1.0f / (float)n;
+
+    std::vector<int> small, large;
+    std::vector<float> scaled(n);
+    for(int i=0; i < n; ++i) {
+        scaled[i] = p[i] * (float)n;
+        (scaled[i] < 1 ? small : large).push_back(i);
+    }
+
+    while(!small.empty() && !large.empty()) {
+        const int s = small.back(); small.pop_back();
+        const int l = large.back(); large.pop_back();
+        prob[s] = scaled[s];
+        alias[s] = l;
+        scaled[l] -= 1 - scaled[s];
+        (scaled[l] < 1 ? small : large).push_back(l);
+    }
+    // Leftovers are 1 up to rounding
+    for(int i : large) { prob[i] = 1; alias[i] = i; }
+    for(int i : small) { prob[i] = 1; alias[i] = i; }
+}
+
+class distribution_2d {
+    // Piecewise-constant distribution over a width x height grid: a marginal table over rows
+    // and one conditional table per row.
+public:
+    distribution_2d() = default;
+    distribution_2d(const std::vector<float>& weights, int w, int h) : width{w}, height{h} {
+        std::vector<float> row_sums(h);
+        for(int j=0; j < h; ++j) {
+            std::vector<float> row(weights.begin() + j*w, weights.begin() + (j+1)*w);
+            conditional.emplace_back(row);
+            row_sums[j] = conditional.back().total();
+        }
+        marginal = alias_table(row_sums);
+    }
+
+    void sample(float u1, float u2, int& i, int& j, float& pmf) const {
+        j = marginal.sample(u1);
+        i = conditional[j].sample(u2);
+        pmf = marginal.pmf(j) * conditional[j].pmf(i);
+    }
+
+    [[nodiscard]] float pmf(int i, int j) const {
+        return marginal.pmf(j) * conditional[j].pmf(i);
+    }
+
+    int width{}, height{};
+
+private:
+    alias_table marginal;
+    std::vector<alias_table> conditional;
+};
+
+#endif //RAYTRACING_DISTRIBUTION_HPP
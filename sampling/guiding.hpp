@@ -0,0 +1,266 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#ifndef RAYTRACING_GUIDING_HPP
+#define RAYTRACING_GUIDING_HPP
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "rtweekend.hpp"
+#include "hittable/aabb.hpp"
+
+class dtree {
+    // Directional quadtree over the (cos theta, phi) square, which maps area to solid angle
+    // uniformly. Every node keeps the energy recorded in each of its four quadrants; a quadrant
+    // with a child is subdivided further. Recording is lock-free, the structure only changes in
+    // refined().
+public:
+    dtree() { nodes.emplace_back(); }
+
+    [[nodiscard]] float total() const {
+        const node& root = nodes[0];
+        return root.sum[0].load(std::memory_order_relaxed) + root.sum[1].load(std::memory_order_relaxed)
+             + root.sum[2].load(std::memory_order_relaxed) + root.sum[3].load(std::memory_order_relaxed);
+    }
+
+    void record(float x, float y, float value) {
+        int i = 0;
+        while(true) {
+            const int q = quadrant(x, y);
+            nodes[i].sum[q].fetch_add(value, std::memory_order_relaxed);
+            if(!nodes[i].child[q]) return;
+            i = nodes[i].child[q];
+        }
+    }
+
+    // Density over the unit square; parts of the tree that saw no energy are uniform
+    [[nodiscard]] float pdf(float x, float y) const {
+        float pdf = 1;
+        int i = 0;
+        while(true) {
+            const node& n = nodes[i];
+            const float sum = n.total();
+            if(sum <= 0) return pdf;
+            const int q = quadrant(x, y);
+            pdf *= 4 * n.sum[q].load(std::memory_order_relaxed) / sum;
+            if(!n.child[q] || pdf <= 0) return pdf;
+            i = n.child[q];
+        }
+    }
+
+    void sample(float& x, float& y) const {
+        // Descend by the quadrant energies, then place the point uniformly in the leaf quadrant.
+        // Each level draws a fresh number; reusing one would run out of precision deep in the tree.
+        float ox = 0, oy = 0, size = 1;
+        int i = 0;
+        while(true) {
+            const node& n = nodes[i];
+            const float sum = n.total();
+            const float u = random_float() * sum;
+            int q = 0;
+            if(sum > 0) {
+                float acc = n.sum[0].load(std::memory_order_relaxed);
+                while(q < 3 && (u >= acc || n.sum[q].load(std::memory_order_relaxed) <= 0))
+                    acc += n.sum[++q].load(std::memory_order_relaxed);
+            }
+            else {
+                q = std::min(int(random_float() * 4), 3);
+            }
+            size *= .5f;
+            ox += float(q & 1) * size;
+            oy += float(q >> 1) * size;
+            if(sum <= 0 || !n.child[q]) break;
+            i = n.child[q];
+        }
+        x = ox + random_float() * size;
+        y = oy + random_float() * size;
+    }
+
+    // Empty tree whose leaves split wherever this one saw more than fraction of its energy
+    [[nodiscard]] dtree refined(float fraction, int max_depth) const {
+        struct item { int to, from, depth; float energy; };
+        dtree out;
+        const float sum = total();
+        if(sum <= 0) return out;
+
+        std::vector<item> stack{{0, 0, 1, sum}};
+        while(!stack.empty()) {
+            const item it = stack.back();
+            stack.pop_back();
+            for(int q=0; q < 4; ++q) {
+                const float e = it.from >= 0 ? nodes[it.from].sum[q].load(std::memory_order_relaxed) : it.energy / 4;
+                if(e / sum <= fraction || it.depth >= max_depth) continue;
+                const int c = int(out.nodes.size());
+                out.nodes.emplace_back();
+                out.nodes[it.to].child[q] = c;
+                stack.push_back({c, it.from >= 0 && nodes[it.from].child[q] ? nodes[it.from].child[q] : -1,
+                                 it.depth + 1, e});
+            }
+        }
+        return out;
+    }
+
+private:
+    struct node {
+        std::atomic<float> sum[4]{};
+        int child[4]{}; // 0 for quadrants without a child, the root is never one
+
+        node() = default;
+        node(const node& o) { *this = o; }
+        node& operator=(const node& o) {
+            for(int q=0; q < 4; ++q) {
+                sum[q].store(o.sum[q].load(std::memory_order_relaxed), std::memory_order_relaxed);
+                child[q] = o.child[q];
+            }
+            return *this;
+        }
+
+        [[nodiscard]] float total() const {
+            return sum[0].load(std::memory_order_relaxed) + sum[1].load(std::memory_order_relaxed)
+                 + sum[2].load(std::memory_order_relaxed) + sum[3].load(std::memory_order_relaxed);
+        }
+    };
+
+    std::vector<node> nodes;
+
+    static int quadrant(float& x, float& y) {
+        // Quadrant of (x, y), which is rescaled into that quadrant's own unit square
+        const int qx = x >= .5f, qy = y >= .5f;
+        x = fclamp(x * 2 - float(qx), 0, 1);
+        y = fclamp(y * 2 - float(qy), 0, 1);
+        return qx | qy << 1;
+    }
+};
+
+class guiding_field {
+    // Online path guiding after Mueller et al.'s practical path guiding: a binary tree over
+    // space whose leaves hold directional quadtrees of incident radiance. Each training pass
+    // records into the building trees; refine() then splits busy leaves, turns the recorded
+    // trees into the sampling distribution and restructures the building trees for the next
+    // pass. refine() must not run concurrently with anything else.
+public:
+    static constexpr float guide_fraction = .5f;     // one-sample MIS probability of guiding vs the BSDF
+    static constexpr unsigned spatial_threshold = 4000; // samples per pass before a leaf splits
+    static constexpr float directional_threshold = .01f;
+    static constexpr int max_directional_depth = 20;
+    static constexpr int max_spatial_depth = 60;
+
+    guiding_field(const aabb& b, unsigned passes) : bounds{b}, training_passes{passes} {
+        nodes.push_back({0, {0, 0}, 0, 0});
+        leaves.push_back(std::make_unique<leaf>());
+    }
+
+    // Number of completed training passes
+    [[nodiscard]] unsigned iteration() const { return iter.load(std::memory_order_acquire); }
+    [[nodiscard]] bool ready() const { return iteration() > 0; }
+    [[nodiscard]] bool training() const { return iteration() < training_passes; }
+    [[nodiscard]] unsigned passes() const { return training_passes; }
+
+    [[nodiscard]] vec3 sample(const point3& p) const {
+        float x, y;
+        find(p).sampling.sample(x, y);
+        return to_direction(x, y);
+    }
+
+    [[nodiscard]] float pdf(const point3& p, const vec3& dir) const {
+        float x, y;
+        to_square(unit_vector(dir), x, y);
+        return find(p).sampling.pdf(x, y) / (4*fpi);
+    }
+
+    // value estimates incident radiance from dir divided by the pdf it was sampled with
+    void record(const point3& p, const vec3& dir, float value) {
+        if(!(value > 0) || value == f_infinity) return;
+        float x, y;
+        to_square(unit_vector(dir), x, y);
+        leaf& l = find(p);
+        l.building.record(x, y, value);
+        l.samples.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void refine() {
+        // Split leaves until each would have seen at most spatial_threshold samples,
+        // assuming samples divide evenly between children
+        std::vector<std::pair<int, unsigned>> stack;
+        for(int i=0; i < (int)nodes.size(); ++i)
+            if(nodes[i].child[0] == 0) stack.emplace_back(i, leaves[nodes[i].leaf]->samples.load());
+        while(!stack.empty()) {
+            const auto [i, samples] = stack.back();
+            stack.pop_back();
+            if(samples <= spatial_threshold || nodes[i].depth >= max_spatial_depth) continue;
+
+            // The first child keeps the parent's leaf, the second gets a copy of its trees
+            const int parent_leaf = nodes[i].leaf;
+            auto copy = std::make_unique<leaf>();
+            copy->building = leaves[parent_leaf]->building;
+            leaves.push_back(std::move(copy));
+
+            const node split = nodes[i];
+            for(int c=0; c < 2; ++c) {
+                nodes[i].child[c] = int(nodes.size());
+                stack.emplace_back(int(nodes.size()), samples / 2);
+                nodes.push_back({(split.axis + 1) % 3, {0, 0}, c ? int(leaves.size()) - 1 : parent_leaf, split.depth + 1});
+            }
+            nodes[i].leaf = -1;
+        }
+
+        for(auto& l : leaves) {
+            l->sampling = l->building;
+            l->building = l->building.refined(directional_threshold, max_directional_depth);
+            l->samples = 0;
+        }
+        iter.fetch_add(1, std::memory_order_release);
+    }
+
+private:
+    struct node {
+        int axis;
+        int child[2]; // 0 for leaves
+        int leaf;     // index into leaves, -1 for interior nodes
+        int depth;
+    };
+    struct leaf {
+        dtree sampling, building;
+        std::atomic<unsigned> samples{0};
+    };
+
+    aabb bounds;
+    unsigned training_passes;
+    std::atomic<unsigned> iter{0};
+    std::vector<node> nodes;
+    std::vector<std::unique_ptr<leaf>> leaves;
+
+    [[nodiscard]] leaf& find(const point3& p) const {
+        // Walk down the midpoint splits in coordinates relative to the bounds
+        vec3 q;
+        for(int a=0; a < 3; ++a) {
+            const float extent = bounds.max()[a] - bounds.min()[a];
+            q[a] = extent > 0 ? fclamp((p[a] - bounds.min()[a]) / extent, 0, 1) : .5f;
+        }
+        int i = 0;
+        while(nodes[i].child[0]) {
+            const int a = nodes[i].axis;
+            const int c = q[a] >= .5f;
+            q[a] = fclamp(q[a] * 2 - float(c), 0, 1);
+            i = nodes[i].child[c];
+        }
+        return *leaves[nodes[i].leaf];
+    }
+
+    static void to_square(const vec3& d, float& x, float& y) {
+        x = fclamp((d.z() + 1) * .5f, 0, 1);
+        y = fclamp((atan2f(d.y(), d.x()) + fpi) / (2*fpi), 0, 1);
+    }
+
+    static vec3 to_direction(float x, float y) {
+        const float cos_theta = 2*x - 1;
+        const float sin_theta = sqrtf(fmax(0.f, 1 - cos_theta*cos_theta));
+        const float phi = 2*fpi*y - fpi;
+        return vec3(sin_theta * cosf(phi), sin_theta * sinf(phi), cos_theta);
+    }
+};
+
+#endif //RAYTRACING_GUIDING_HPP
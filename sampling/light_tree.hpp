@@ -0,0 +1,313 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#ifndef RAYTRACING_LIGHT_TREE_HPP
+#define RAYTRACING_LIGHT_TREE_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "rtweekend.hpp"
+#include "color.hpp"
+#include "hittable/hittable.hpp"
+#include "modifiers/material.hpp"
+
+struct light_bounds {
+    // Bounds of a cluster of emitters: where they are, which way they face and how bright they are
+    aabb box;
+    vec3 axis;
+    float cos_theta_o{1};
+    float phi{0};
+
+    [[nodiscard]] point3 centroid() const { return .5f * (box.min() + box.max()); }
+
+    [[nodiscard]] float importance(const point3& p, const vec3& n) const;
+};
+
+inline float cos_sub_clamped(float sin_a, float cos_a, float sin_b, float cos_b) {
+    // cos(max(0, a - b))
+    if(cos_a > cos_b) return 1;
+    return cos_a * cos_b + sin_a * sin_b;
+}
+
+inline float sin_sub_clamped(float sin_a, float cos_a, float sin_b, float cos_b) {
+    // sin(max(0, a - b))
+    if(cos_a > cos_b) return 0;
+    return sin_a * cos_b - cos_a * sin_b;
+}
+
+inline float safe_sin(float cos_theta) {
+    return sqrtf(fmax(0.f, 1 - cos_theta * cos_theta));
+}
+
+float light_bounds::importance(const point3& p, const vec3& n) const {
+    // Conservative estimate of the light a cluster can send to p (see pbrt-v4's LightBounds).
+    // Emitters are diffuse, so the emission falloff angle is pi/2.
+    if(phi <= 0) return 0;
+
+    const point3 pc = centroid();
+    const vec3 diag = box.max() - box.min();
+    const float d2 = fmax((p - pc).length_squared(), .5f * diag.length());
+
+    const vec3 wi = unit_vector(p - pc);
+    const float cos_w = dot(axis, wi);
+    const float sin_w = safe_sin(cos_w);
+
+    // Angle subtended by the bounding sphere of the box
+    const float r2 = .25f * diag.length_squared();
+    float cos_b = -1;
+    if((p - pc).length_squared() > r2)
+        cos_b = sqrtf(fmax(0.f, 1 - r2 / (p - pc).length_squared()));
+    const float sin_b = safe_sin(cos_b);
+
+    const float sin_o = safe_sin(cos_theta_o);
+    const float cos_x = cos_sub_clamped(sin_w, cos_w, sin_o, cos_theta_o);
+    const float sin_x = sin_sub_clamped(sin_w, cos_w, sin_o, cos_theta_o);
+    const float cos_p = cos_sub_clamped(sin_x, cos_x, sin_b, cos_b);
+    if(cos_p <= 0)
+        return 0;
+
+    float imp = phi * cos_p / d2;
+    if(n.length_squared() > 0) {
+        const float cos_i = fabs(dot(wi, n));
+        imp *= cos_sub_clamped(safe_sin(cos_i), cos_i, sin_b, cos_b);
+    }
+    return fmax(imp, 0.f);
+}
+
+inline vec3 rotate_about(const vec3& v, const vec3& k, float theta) {
+    // Rodrigues' rotation of v around the unit axis k
+    return v * cosf(theta) + cross(k, v) * sinf(theta) + k * dot(k, v) * (1 - cosf(theta));
+}
+
+light_bounds union_bounds(const light_bounds& a, const light_bounds& b) {
+    if(a.phi <= 0) return b;
+    if(b.phi <= 0) return a;
+
+    light_bounds out;
+    out.box = surrounding_box(a.box, b.box);
+    out.phi = a.phi + b.phi;
+
+    // Smallest cone holding both normal cones
+    const float theta_a = acosf(fclamp(a.cos_theta_o, -1, 1));
+    const float theta_b = acosf(fclamp(b.cos_theta_o, -1, 1));
+    const float theta_d = acosf(fclamp(dot(a.axis, b.axis), -1, 1));
+    if(fmin(theta_d + theta_b, fpi) <= theta_a) {
+        out.axis = a.axis;
+        out.cos_theta_o = a.cos_theta_o;
+        return out;
+    }
+    if(fmin(theta_d + theta_a, fpi) <= theta_b) {
+        out.axis = b.axis;
+        out.cos_theta_o = b.cos_theta_o;
+        return out;
+    }
+
+    const float theta_o = .5f * (theta_a + theta_d + theta_b);
+    const vec3 wr = cross(a.axis, b.axis);
+    if(theta_o >= fpi || wr.length_squared() < 1e-12f) {
+        out.axis = a.axis;
+        out.cos_theta_o = -1;
+        return out;
+    }
+    out.axis = unit_vector(rotate_about(a.axis, unit_vector(wr), theta_o - theta_a));
+    out.cos_theta_o = cosf(theta_o);
+    return out;
+}
+
+class light_tree {
+    // Bounding volume hierarchy over the emitters of a scene. Sampling walks down from the root,
+    // picking each child in proportion to its importance at the shading point.
+public:
+    light_tree() = default;
+    explicit light_tree(const hittable& world);
+
+    [[nodiscard]] bool empty() const { return lights.empty(); }
+    [[nodiscard]] size_t size() const { return lights.size(); }
+    [[nodiscard]] const light_info& light(int i) const { return lights[i]; }
+
+    // Index of the light with obj as its shape, or -1
+    [[nodiscard]] int index_of(const hittable* obj) const {
+        const auto it = index.find(obj);
+        return it == index.end() ? -1 : it->second;
+    }
+
+    [[nodiscard]] int sample(const point3& p, const vec3& n, float u, float& pmf) const;
+    [[nodiscard]] float pmf(const point3& p, const vec3& n, int light) const;
+
+private:
+    struct node {
+        light_bounds bounds;
+        int second_child{-1}; // first child is the next node
+        int light{-1};        // light index for leaves
+    };
+
+    std::vector<light_info> lights;
+    std::vector<light_bounds> bounds;
+    std::vector<uint64_t> trails; // left/right choices from the root, one bit per level
+    std::vector<node> nodes;
+    std::unordered_map<const hittable*, int> index;
+
+    int build(std::vector<int>& ids, int start, int end, uint64_t trail, int depth);
+};
+
+light_tree::light_tree(const hittable& world) {
+    std::vector<light_info> candidates;
+    world.collect_lights(candidates);
+
+    for(const auto& l : candidates) {
+        const float power = luminance(l.mat->emission()) * l.area * fpi;
+        if(power <= 0) continue;
+        lights.push_back(l);
+        bounds.push_back({l.box, l.axis, l.cos_theta_o, power});
+    }
+    if(lights.empty()) return;
+
+    trails.resize(lights.size());
+    std::vector<int> ids(lights.size());
+    for(int i=0; i < (int)lights.size(); ++i) {
+        ids[i] = i;
+        index[lights[i].obj] = i;
+    }
+    build(ids, 0, int(ids.size()), 0, 0);
+}
+
+int light_tree::build(std::vector<int>& ids, int start, int end, uint64_t trail, int depth) {
+    const int at = int(nodes.size());
+    nodes.emplace_back();
+
+    if(end - start == 1) {
+        nodes[at].bounds = bounds[ids[start]];
+        nodes[at].light = ids[start];
+        trails[ids[start]] = trail;
+        return at;
+    }
+
+    light_bounds all;
+    for(int i=start; i < end; ++i) all = union_bounds(all, bounds[ids[i]]);
+    point3 cmin(f_infinity, f_infinity, f_infinity), cmax(-f_infinity, -f_infinity, -f_infinity);
+    for(int i=start; i < end; ++i) {
+        const point3 c = bounds[ids[i]].centroid();
+        for(int a=0; a < 3; ++a) {
+            cmin[a] = fmin(cmin[a], c[a]);
+            cmax[a] = fmax(cmax[a], c[a]);
+        }
+    }
+
+    // Bucketed surface area orientation heuristic: cost of a side is its power times the
+    // orientation measure of its normal cone times its surface area.
+    auto orientation_measure = [](const light_bounds& b) {
+        const float theta_o = acosf(fclamp(b.cos_theta_o, -1, 1));
+        const float theta_w = fmin(theta_o + fpi/2, fpi);
+        const float sin_o = sinf(theta_o);
+        return 2*fpi*(1 - b.cos_theta_o)
+             + fpi/2 * (2*theta_w*sin_o - cosf(theta_o - 2*theta_w) - 2*theta_o*sin_o + b.cos_theta_o);
+    };
+    auto surface_area = [](const aabb& b) {
+        const vec3 d = b.max() - b.min();
+        return 2 * (d.x()*d.y() + d.x()*d.z() + d.y()*d.z());
+    };
+
+    constexpr int n_buckets = 12;
+    const vec3 extent = all.box.max() - all.box.min();
+    const float max_extent = fmax(extent.x(), fmax(extent.y(), extent.z()));
+    float best_cost = f_infinity;
+    int best_axis = -1, best_split = -1;
+    for(int a=0; a < 3; ++a) {
+        if(cmax[a] <= cmin[a]) continue;
+        light_bounds buckets[n_buckets];
+        for(int i=start; i < end; ++i) {
+            int b = int(n_buckets * (bounds[ids[i]].centroid()[a] - cmin[a]) / (cmax[a] - cmin[a]));
+            b = std::min(b, n_buckets - 1);
+            buckets[b] = union_bounds(buckets[b], bounds[ids[i]]);
+        }
+        const float kr = max_extent / fmax(extent[a], 1e-6f);
+        for(int split=0; split < n_buckets - 1; ++split) {
+            light_bounds below, above;
+            for(int b=0; b <= split; ++b) below = union_bounds(below, buckets[b]);
+            for(int b=split+1; b < n_buckets; ++b) above = union_bounds(above, buckets[b]);
+            const float cost = kr * (below.phi * orientation_measure(below) * surface_area(below.box)
+                                   + above.phi * orientation_measure(above) * surface_area(above.box));
+            if(below.phi > 0 && above.phi > 0 && cost < best_cost) {
+                best_cost = cost;
+                best_axis = a;
+                best_split = split;
+            }
+        }
+    }
+
+    int mid;
+    if(best_axis >= 0) {
+        const int a = best_axis;
+        const auto it = std::partition(ids.begin() + start, ids.begin() + end, [&](int id) {
+            int b = int(n_buckets * (bounds[id].centroid()[a] - cmin[a]) / (cmax[a] - cmin[a]));
+            return std::min(b, n_buckets - 1) <= best_split;
+        });
+        mid = int(it - ids.begin());
+    }
+    else {
+        // Coincident centroids: split by count
+        mid = (start + end) / 2;
+    }
+    if(mid == start || mid == end || depth >= 48)
+        mid = (start + end) / 2;
+
+    build(ids, start, mid, trail, depth + 1);
+    nodes[at].second_child = build(ids, mid, end, trail | (uint64_t(1) << depth), depth + 1);
+    nodes[at].bounds = all;
+    return at;
+}
+
+int light_tree::sample(const point3& p, const vec3& n, float u, float& pmf) const {
+    pmf = 1;
+    if(nodes.empty()) return -1;
+
+    int i = 0;
+    while(nodes[i].light < 0) {
+        const float c0 = nodes[i + 1].bounds.importance(p, n);
+        const float c1 = nodes[nodes[i].second_child].bounds.importance(p, n);
+        if(c0 <= 0 && c1 <= 0) return -1;
+
+        const float p0 = c0 / (c0 + c1);
+        if(u < p0) {
+            i = i + 1;
+            u = fmin(u / p0, .99999994f);
+            pmf *= p0;
+        }
+        else {
+            i = nodes[i].second_child;
+            u = fmin((u - p0) / (1 - p0), .99999994f);
+            pmf *= 1 - p0;
+        }
+    }
+    return nodes[i].light;
+}
+
+float light_tree::pmf(const point3& p, const vec3& n, int light) const {
+    // Replays the choices sample() would make on the way down to light
+    if(light < 0 || nodes.empty()) return 0;
+
+    const uint64_t trail = trails[light];
+    float pmf = 1;
+    int i = 0;
+    for(int depth = 0; nodes[i].light < 0; ++depth) {
+        const float c0 = nodes[i + 1].bounds.importance(p, n);
+        const float c1 = nodes[nodes[i].second_child].bounds.importance(p, n);
+        if(c0 <= 0 && c1 <= 0) return 0;
+
+        if(trail & (uint64_t(1) << depth)) {
+            pmf *= c1 / (c0 + c1);
+            i = nodes[i].second_child;
+        }
+        else {
+            pmf *= c0 / (c0 + c1);
+            i = i + 1;
+        }
+    }
+    return pmf;
+}
+
+#endif //RAYTRACING_LIGHT_TREE_HPP
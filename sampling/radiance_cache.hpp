@@ -0,0 +1,108 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#ifndef RAYTRACING_RADIANCE_CACHE_HPP
+#define RAYTRACING_RADIANCE_CACHE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "rtweekend.hpp"
+#include "color.hpp"
+
+class radiance_cache {
+    // Hashed world-space cache of the radiance reflected off diffuse surfaces. Cells are keyed on
+    // position quantized to cell_size and on the dominant axis of the normal, and accumulate the
+    // estimates of finished paths. Paths at least query_depth bounces deep stop at a cell with
+    // min_samples or more and use its mean instead. Bigger cells and fewer required samples
+    // terminate more paths (less variance and time, more bias).
+    //
+    // The table is open-addressed with linear probing. Slots are claimed by compare-and-swap on
+    // the key and sums are atomic adds, so all threads can update it without locks.
+public:
+    radiance_cache(float cell, unsigned depth, unsigned min_count, unsigned log2_capacity = 18)
+            : cell_size{cell}, query_depth{depth}, min_samples{min_count},
+              mask{(uint64_t(1) << log2_capacity) - 1}, entries(std::make_unique<entry[]>(mask + 1)) {}
+
+    [[nodiscard]] unsigned depth() const { return query_depth; }
+
+    bool lookup(const point3& p, const vec3& n, color& out) const {
+        const entry* e = find(key(p, n));
+        if(!e) return false;
+        const unsigned count = e->count.load(std::memory_order_acquire);
+        if(count < min_samples) return false;
+        out = color(e->sum[0].load(std::memory_order_relaxed), e->sum[1].load(std::memory_order_relaxed),
+                    e->sum[2].load(std::memory_order_relaxed)) / float(count);
+        return true;
+    }
+
+    void record(const point3& p, const vec3& n, const color& radiance) {
+        for(int c=0; c < 3; ++c)
+            if(!(radiance[c] >= 0) || radiance[c] == f_infinity) return;
+        entry* e = claim(key(p, n));
+        if(!e) return; // table full around this key
+        for(int c=0; c < 3; ++c)
+            e->sum[c].fetch_add(radiance[c], std::memory_order_relaxed);
+        e->count.fetch_add(1, std::memory_order_release);
+    }
+
+private:
+    static constexpr int max_probes = 16;
+
+    struct entry {
+        std::atomic<uint64_t> key{0}; // 0 marks an empty slot
+        std::atomic<float> sum[3]{};
+        std::atomic<unsigned> count{0};
+    };
+
+    float cell_size;
+    unsigned query_depth;
+    unsigned min_samples;
+    uint64_t mask;
+    std::unique_ptr<entry[]> entries;
+
+    [[nodiscard]] uint64_t key(const point3& p, const vec3& n) const {
+        // splitmix64 over the packed cell coordinates and normal bin
+        int axis = 0;
+        for(int a=1; a < 3; ++a)
+            if(fabs(n[a]) > fabs(n[axis])) axis = a;
+        const uint64_t bin = uint64_t(axis * 2 + (n[axis] < 0));
+
+        uint64_t h = bin;
+        for(int a=0; a < 3; ++a) {
+            const auto q = (int64_t)floorf(p[a] / cell_size);
+            h = h * 0x9e3779b97f4a7c15ull + uint64_t(q & 0x1fffff);
+            h ^= h >> 30;
+            h *= 0xbf58476d1ce4e5b9ull;
+            h ^= h >> 27;
+            h *= 0x94d049bb133111ebull;
+            h ^= h >> 31;
+        }
+        return h ? h : 1;
+    }
+
+    [[nodiscard]] const entry* find(uint64_t k) const {
+        for(int i=0; i < max_probes; ++i) {
+            const entry& e = entries[(k + i) & mask];
+            const uint64_t stored = e.key.load(std::memory_order_acquire);
+            if(stored == k) return &e;
+            if(stored == 0) return nullptr;
+        }
+        return nullptr;
+    }
+
+    entry* claim(uint64_t k) {
+        for(int i=0; i < max_probes; ++i) {
+            entry& e = entries[(k + i) & mask];
+            uint64_t stored = e.key.load(std::memory_order_acquire);
+            if(stored == 0 && e.key.compare_exchange_strong(stored, k, std::memory_order_acq_rel))
+                return &e;
+            if(stored == k) return &e;
+        }
+        return nullptr;
+    }
+};
+
+#endif //RAYTRACING_RADIANCE_CACHE_HPP
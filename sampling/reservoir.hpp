@@ -0,0 +1,48 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#ifndef RAYTRACING_RESERVOIR_HPP
+#define RAYTRACING_RESERVOIR_HPP
+
+#include "rtweekend.hpp"
+#include "color.hpp"
+
+struct light_candidate {
+    // A point on an emitter, with everything needed to re-evaluate it from another shading point
+    int light{-1};
+    point3 x;
+    vec3 n;   // normal on the emitting side
+    color le; // emitted radiance on that side
+};
+
+struct reservoir {
+    // Weighted reservoir sampling over light candidates: y is kept with probability proportional
+    // to its weight among all candidates streamed through. W is the unbiased contribution weight
+    // of y once finalize() has been called.
+    light_candidate y;
+    float w_sum{0};
+    float M{0};
+    float W{0};
+
+    bool update(const light_candidate& c, float w, float m = 1) {
+        w_sum += w;
+        M += m;
+        if(w > 0 && random_float() * w_sum < w) {
+            y = c;
+            return true;
+        }
+        return false;
+    }
+
+    void finalize(float p_hat) {
+        W = p_hat > 0 && M > 0 ? w_sum / (M * p_hat) : 0;
+    }
+
+    // For merges whose weights already carry MIS weights summing to one, instead of 1/M
+    void finalize_mis(float p_hat) {
+        W = p_hat > 0 ? w_sum / p_hat : 0;
+    }
+};
+
+#endif //RAYTRACING_RESERVOIR_HPP
@@ -0,0 +1,42 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#ifndef RAYTRACING_SCENE_HPP
+#define RAYTRACING_SCENE_HPP
+
+#include <algorithm>
+
+#include "rtweekend.hpp"
+#include "hittable/hittable_list.hpp"
+#include "modifiers/environment.hpp"
+#include "modifiers/medium.hpp"
+#include "sampling/guiding.hpp"
+#include "sampling/light_tree.hpp"
+#include "sampling/radiance_cache.hpp"
+
+struct scene {
+    // Everything the integrator needs besides the camera
+    hittable_list world;
+    color background{0,0,0};
+    shared_ptr<environment> env{}; // replaces background when set
+    light_tree lights{};           // built from the emitters in world by build_lights()
+    std::vector<shared_ptr<medium>> media{};
+    shared_ptr<guiding_field> guide{}; // trained during progressive passes when set
+    shared_ptr<radiance_cache> cache{}; // ends deep diffuse paths when set
+
+    void build_lights() {
+        lights = light_tree(world);
+    }
+
+    // True when every medium can report exact distance sampling pdfs
+    [[nodiscard]] bool analytic_media() const {
+        return std::all_of(media.begin(), media.end(), [](const auto& m) { return m->analytic(); });
+    }
+
+    [[nodiscard]] color miss(const ray& r) const {
+        return env ? env->value(unit_vector(r.direction())) : background;
+    }
+};
+
+#endif //RAYTRACING_SCENE_HPP
@@ -0,0 +1,143 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#ifndef RAYTRACING_SCENE_SELECT_HPP
+#define RAYTRACING_SCENE_SELECT_HPP
+
+#include <string>
+#include <vector>
+
+#include "camera.hpp"
+#include "scene.hpp"
+#include "scenes.hpp"
+
+struct scene_setup {
+    // A scene together with the view it is meant to be rendered from
+    scene scn;
+    point3 lookfrom{0, 0, 0};
+    point3 lookat{0, 0, -1};
+    float vfov{40};
+    float aperture{0};
+    float aspect_ratio{16.f/9.f};
+    float time0{0}, time1{1}; // shutter interval; moving objects are built for times in [0, 1]
+
+    [[nodiscard]] camera make_camera() const {
+        return {lookfrom, lookat, vec3(0, 1, 0), vfov, aspect_ratio, aperture, 10.0f, time0, time1};
+    }
+};
+
+inline const std::vector<std::string>& scene_names() {
+    static const std::vector<std::string> names{
+        "random", "coin", "mesh", "moving_spheres", "cornell", "cornell_smoke", "final", "cylinder",
+        "cone", "mapped_box", "cornell_glass", "many_lights", "cornell_cloud"
+    };
+    return names;
+}
+
+inline scene_setup obj_scene(const std::string& path) {
+    // An OBJ mesh scaled to two units across, standing on a grey ground under the sky
+    const auto grey = make_shared<lambertian>(color(.7f, .7f, .7f));
+    point3 lo(f_infinity, f_infinity, f_infinity), hi = -lo;
+    for(const point3& v : mesh(path, grey, point3(0, 0, 0), 1).vertices) {
+        lo = point3(fmin(lo.x(), v.x()), fmin(lo.y(), v.y()), fmin(lo.z(), v.z()));
+        hi = point3(fmax(hi.x(), v.x()), fmax(hi.y(), v.y()), fmax(hi.z(), v.z()));
+    }
+    if(lo.x() > hi.x()) lo = hi = point3(0, 0, 0);
+    const vec3 extent = hi - lo;
+    const float size = fmax(extent.x(), fmax(extent.y(), extent.z()));
+    const float scale = size > 0 ? 2 / size : 1;
+    const point3 centre = (lo + hi) / 2;
+    const point3 origin = -scale * point3(centre.x(), lo.y(), centre.z());
+
+    scene_setup s;
+    s.scn.world.add(make_shared<mesh>(path, grey, origin, scale));
+    s.scn.world.add(make_shared<sphere>(point3(0, -1000, 0), 1000, make_shared<lambertian>(color(.5f, .5f, .5f))));
+    s.scn.background = color(.7f, .8f, 1.0f);
+    s.lookat = point3(0, scale * extent.y() / 2, 0);
+    s.lookfrom = s.lookat + vec3(0, 1, -4.5f);
+    s.vfov = 30;
+    return s;
+}
+
+inline bool select_scene(const std::string& name, scene_setup& s) {
+    // Builds a scene from scene_names() or, for a path ending in .obj, around that mesh.
+    // False if the name is unknown.
+    if(name.size() > 4 && name.compare(name.size() - 4, 4, ".obj") == 0) {
+        s = obj_scene(name);
+        return true;
+    }
+
+    s = scene_setup{};
+    scene& scn = s.scn;
+    if(name == "random") {
+        scn.world = random_scene();
+        scn.background = color(.7f, .8f, 1.0f);
+        s.lookfrom = point3(13, 2, 3);
+        s.lookat = point3(0, 0, 0);
+        s.vfov = 20.0f;
+        s.aperture = .1f;
+    }
+    else if(name == "coin") {
+        scn.world = gold_coin();
+        s.lookfrom = point3(0, 4, -3);
+        s.lookat = point3(0, 0, 0);
+    }
+    else if(name == "mesh") {
+        scn.world = mesh_test();
+        scn.background = color(.7f, .8f, 1.0f);
+        s.lookfrom = point3(0, 1, -7);
+        s.lookat = point3(0, 1, 0);
+    }
+    else if(name == "moving_spheres") {
+        scn.world = moving_spheres();
+        s.lookfrom = point3(378, 300, 50);
+        s.lookat = point3(-150, -150, -150);
+        s.aspect_ratio = 3.0f/2.0f;
+    }
+    else if(name == "cornell" || name == "cornell_smoke" || name == "cornell_glass"
+            || name == "many_lights" || name == "cornell_cloud") {
+        if(name == "cornell") scn.world = cornell_box();
+        else if(name == "cornell_smoke") {
+            scn.world = cornell_smoke();
+            scn.media = cornell_smoke_media();
+        }
+        else if(name == "cornell_glass") scn.world = cornell_glass();
+        else if(name == "many_lights") scn.world = many_lights();
+        else {
+            scn.world = cornell_box();
+            scn.media.push_back(perlin_cloud());
+        }
+        s.lookfrom = point3(278, 278, -800);
+        s.lookat = point3(278, 278, 0);
+    }
+    else if(name == "final") {
+        scn.world = final_scene();
+        // Thin fog out to 5000 units; rays that leave it reach the background
+        const auto fog = make_shared<sphere>(point3(0, 0, 0), 5000, make_shared<dielectric>(1.5f));
+        scn.media.push_back(make_shared<homogeneous_medium>(.0001f, color(1, 1, 1), fog));
+        s.lookfrom = point3(478, 278, -600);
+        s.lookat = point3(278, 278, 0);
+    }
+    else if(name == "cylinder" || name == "cone") {
+        scn.world = name == "cylinder" ? single_cylinder() : single_cone();
+        scn.background = color(.7f, .8f, 1.0f);
+        s.lookfrom = name == "cylinder" ? point3(0, 2, -15) : point3(13, 2, 3);
+        s.lookat = point3(0, 0, 0);
+        s.vfov = 20.0f;
+        s.aperture = .1f;
+    }
+    else if(name == "mapped_box") {
+        scn.world = mapped_box();
+        scn.env = storforsen_sky();
+        s.lookfrom = point3(9, -1, 0);
+        s.lookat = point3(0, -1, 0);
+        s.aperture = .02f;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+#endif //RAYTRACING_SCENE_SELECT_HPP
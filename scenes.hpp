@@ -23,6 +23,8 @@
 #include "hittable/cone.hpp"
 #include "hittable/2dhittables.hpp"
 #include "hittable/mesh.hpp"
+#include "modifiers/environment.hpp"
+#include "modifiers/medium.hpp"
 
 hittable_list random_scene() {
     hittable_list world;
@@ -149,6 +151,13 @@ hittable_list cornell_smoke() {
     objects.add(make_shared<xz_rect>(0, 555, 0, 555, 0, white));
     objects.add(make_shared<xy_rect>(0, 555, 0, 555, 555, white));
 
+    return objects;
+}
+
+std::vector<shared_ptr<medium>> cornell_smoke_media() {
+    // The two smoke blocks of cornell_smoke, as media so the integrator can sample them toward the light
+    auto white = make_shared<lambertian>(color(.73, .73, .73));
+
     shared_ptr<hittable> box1 = make_shared<box>(point3(0,0,0), point3(165,330,165), white);
     box1 = make_shared<rotate_y>(box1, 15);
     box1 = make_shared<translate>(box1, vec3(265,0,295));
@@ -157,12 +166,58 @@ hittable_list cornell_smoke() {
     box2 = make_shared<rotate_y>(box2, -18);
     box2 = make_shared<translate>(box2, vec3(130,0,65));
 
-    objects.add(make_shared<constant_medium>(box1, 0.01, color(0,0,0)));
-    objects.add(make_shared<constant_medium>(box2, 0.01, color(1,1,1)));
+    return {make_shared<homogeneous_medium>(0.01f, color(0,0,0), box1),
+            make_shared<homogeneous_medium>(0.01f, color(1,1,1), box2)};
+}
+
+hittable_list many_lights() {
+    // Cornell box lit only by a few hundred small emissive spheres
+    hittable_list objects;
+
+    auto red = make_shared<lambertian>(color(.65f, .05f, .05f));
+    auto white = make_shared<lambertian>(color(.73f, .73f, .73f));
+    auto green = make_shared<lambertian>(color(.12f, .45f, .15f));
+
+    objects.add(make_shared<yz_rect>(0, 555, 0, 555, 555, green));
+    objects.add(make_shared<yz_rect>(0, 555, 0, 555, 0, red));
+    objects.add(make_shared<xz_rect>(0, 555, 0, 555, 0, white));
+    objects.add(make_shared<xz_rect>(0, 555, 0, 555, 555, white));
+    objects.add(make_shared<xy_rect>(0, 555, 0, 555, 555, white));
+
+    hittable_list lights;
+    for(int i=0; i < 300; ++i) {
+        auto emit = make_shared<diffuse_light>(color::random(.5f, 1) * random_float(5, 60));
+        lights.add(make_shared<sphere>(point3(random_float(30, 525), random_float(30, 525), random_float(30, 525)),
+                                       random_float(2, 6), emit));
+    }
+    objects.add(make_shared<bvh_node>(lights, 0, 1));
+
+    shared_ptr<hittable> box1 = make_shared<box>(point3(0,0,0), point3(165,330,165), white);
+    box1 = make_shared<rotate_y>(box1, 15);
+    box1 = make_shared<translate>(box1, vec3(265, 0, 295));
+    objects.add(box1);
 
     return objects;
 }
 
+shared_ptr<medium> perlin_cloud() {
+    // Turbulent cloud in a 64^3 density grid, fading out toward the edges of its box
+    perlin noise;
+    const int n = 64;
+    std::vector<float> density(n * n * n);
+    for(int k=0; k < n; ++k) {
+        for(int j=0; j < n; ++j) {
+            for(int i=0; i < n; ++i) {
+                const point3 p(((float)i + .5f) / n, ((float)j + .5f) / n, ((float)k + .5f) / n);
+                const float falloff = fmax(0.f, 1 - 2 * (p - point3(.5f, .5f, .5f)).length());
+                density[(k * n + j) * n + i] = fmax(0.f, noise.turb(4 * p) - .2f) * falloff;
+            }
+        }
+    }
+    return make_shared<grid_medium>(aabb(point3(80, 60, 80), point3(480, 460, 480)), n, n, n, density,
+                                    .1f, color(.9f, .9f, .9f));
+}
+
 hittable_list moving_spheres() {
     hittable_list spheres;
     auto col1 = make_shared<diffuse_light>(color(.3f, .93f, .91f));
@@ -242,8 +297,6 @@ hittable_list final_scene() {
     auto boundary = make_shared<sphere>(point3(360, 150, 145), 70, make_shared<dielectric>(1.5));
     objects.add(boundary);
     objects.add(make_shared<constant_medium>(boundary, .2f, color(.2f, .4f, .9f)));
-    boundary = make_shared<sphere>(point3(0,0,0), 5000, make_shared<dielectric>(1.5f));
-    objects.add(make_shared<constant_medium>(boundary, .0001f, color(1,1,1)));
 
     auto emat = make_shared<lambertian>(make_shared<image_texture>("resources/earthmap.jpeg"));
     objects.add(make_shared<sphere>(point3(400, 200, 400), 100, emat));
@@ -296,23 +349,17 @@ hittable_list mapped_box() {
 
     objects.add(make_shared<sphere>(point3(3, -1, 0), 1.f, make_shared<metal>(color(.7f,.7f,.7f), 0)));
 
-    std::vector<shared_ptr<material>> skybox = {
-            make_shared<diffuse_light>(make_shared<image_texture>("resources/stor/posz.jpg")),
-            make_shared<diffuse_light>(make_shared<image_texture>("resources/stor/negz.jpg")),
-            make_shared<diffuse_light>(make_shared<image_texture>("resources/stor/posy.jpg")),
-            make_shared<diffuse_light>(make_shared<image_texture>("resources/stor/negy.jpg")),
-            make_shared<diffuse_light>(make_shared<image_texture>("resources/stor/posx.jpg")),
-            make_shared<diffuse_light>(make_shared<image_texture>("resources/stor/negx.jpg"))
-    };
-
-
-    auto emat = make_shared<lambertian>(make_shared<image_texture>("resources/earthmap.jpeg"));
-    shared_ptr<hittable> box1 = make_shared<box>(point3(-10,-10,-10), point3(10,10,10), skybox);
-    objects.add(box1);
-
     return objects;
 }
 
+shared_ptr<environment> storforsen_sky() {
+    return make_shared<environment>(std::vector<std::string>{
+            "resources/stor/posx.jpg", "resources/stor/negx.jpg",
+            "resources/stor/posy.jpg", "resources/stor/negy.jpg",
+            "resources/stor/posz.jpg", "resources/stor/negz.jpg"
+    });
+}
+
 hittable_list gold_coin() {
     hittable_list objects;
 
@@ -21,6 +21,12 @@ public:
         return std::chrono::duration_cast<std::chrono::seconds>(elapsed).count();
     }
 
+    [[nodiscard]] float elapsed() const {
+        // Seconds, with sub-millisecond resolution
+        const auto elapsed = std::chrono::high_resolution_clock::now() - start;
+        return std::chrono::duration<float>(elapsed).count();
+    }
+
     [[nodiscard]] std::string to_string() const {
         int n = (int)get_seconds();
         int h = n / 3600;